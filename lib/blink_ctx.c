@@ -0,0 +1,268 @@
+/*
+ * Copyright 2024 Giles Atkinson
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* Versions of the Blink calls that take an explicit context.  Each
+ * selects the context for the calling thread, makes the usual call and
+ * selects the thread's own again, so that callbacks to the simulator
+ * made during the call see the context given.  The value and flags
+ * calls, where that would be costly, are in sim.c.
+ */
+
+#include <stdint.h>
+#include <glib.h>
+
+#include "sim.h"
+#include "no_gtk.h"
+#include "panel.h"
+
+#define WITH_CTX(ctx, call)                     \
+    do {                                        \
+        struct blink_ctx *caller_;              \
+                                                \
+        caller_ = Ctx;                          \
+        Ctx = (ctx);                            \
+        call;                                   \
+        Ctx = caller_;                          \
+    } while (0)
+
+/* Start-up and clock control. */
+
+int Blink_init_ctx(Blink_ctx ctx, const char *title,
+                   const struct simulator_calls *callbacks,
+                   const char **unit_strings, unsigned int initial_unit)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_init(title, callbacks, unit_strings,
+                                  initial_unit));
+    return rv;
+}
+
+void Blink_set_push_wide_ctx(Blink_ctx ctx,
+                             int (*push_wide)(Sim_RH handle,
+                                              const uint64_t *words))
+{
+    WITH_CTX(ctx, Blink_set_push_wide(push_wide));
+}
+
+void Blink_set_push_batch_ctx(Blink_ctx ctx,
+                              int (*push_batch)(
+                                  const struct blink_edit *edits,
+                                  size_t count))
+{
+    WITH_CTX(ctx, Blink_set_push_batch(push_batch));
+}
+
+void Blink_run_control_ctx(Blink_ctx ctx, struct run_control *rcp)
+{
+    WITH_CTX(ctx, Blink_run_control(rcp));
+}
+
+void Blink_stopped_ctx(Blink_ctx ctx)
+{
+    WITH_CTX(ctx, Blink_stopped());
+}
+
+void Blink_poll_ctx(Blink_ctx ctx, struct run_control *rcp)
+{
+    WITH_CTX(ctx, Blink_poll(rcp));
+}
+
+int Blink_get_fd_ctx(Blink_ctx ctx)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_get_fd());
+    return rv;
+}
+
+/* Set-up of containers and registers. */
+
+Blink_CH Blink_new_row_ctx(Blink_ctx ctx, const char *name)
+{
+    Blink_CH rv;
+
+    WITH_CTX(ctx, rv = Blink_new_row(name));
+    return rv;
+}
+
+Blink_CH Blink_new_overlay_ctx(Blink_ctx ctx, const char *name)
+{
+    Blink_CH rv;
+
+    WITH_CTX(ctx, rv = Blink_new_overlay(name));
+    return rv;
+}
+
+void Blink_add_to_container_ctx(Blink_ctx ctx, Blink_CH item,
+                                Blink_CH container)
+{
+    WITH_CTX(ctx, Blink_add_to_container(item, container));
+}
+
+Blink_CH Blink_new_grid_ctx(Blink_ctx ctx, const char *name, int columns)
+{
+    Blink_CH rv;
+
+    WITH_CTX(ctx, rv = Blink_new_grid(name, columns));
+    return rv;
+}
+
+Blink_CH Blink_new_list_ctx(Blink_ctx ctx, const char *name, int rows)
+{
+    Blink_CH rv;
+
+    WITH_CTX(ctx, rv = Blink_new_list(name, rows));
+    return rv;
+}
+
+void Blink_add_register_ctx(Blink_ctx ctx, const char *name, Sim_RH handle,
+                            unsigned int width, unsigned int options,
+                            Blink_CH container_handle)
+{
+    WITH_CTX(ctx, Blink_add_register(name, handle, width, options,
+                                     container_handle));
+}
+
+Blink_RID Blink_add_register_id_ctx(Blink_ctx ctx, const char *name,
+                                    Sim_RH handle, unsigned int width,
+                                    unsigned int options,
+                                    Blink_CH container_handle)
+{
+    Blink_RID rv;
+
+    WITH_CTX(ctx, rv = Blink_add_register_id(name, handle, width, options,
+                                             container_handle));
+    return rv;
+}
+
+/* Changes during simulation, other than single values and flags. */
+
+void Blink_change_overlay_ctx(Blink_ctx ctx, Blink_CH handle, int value)
+{
+    WITH_CTX(ctx, Blink_change_overlay(handle, value));
+}
+
+void Blink_new_strings_ctx(Blink_ctx ctx, Sim_RH handle,
+                           const char * const *table)
+{
+    WITH_CTX(ctx, Blink_new_strings(handle, table));
+}
+
+void Blink_new_values_ctx(Blink_ctx ctx, const Sim_RH *handles,
+                          const unsigned int *values, unsigned int count)
+{
+    WITH_CTX(ctx, Blink_new_values(handles, values, count));
+}
+
+void Blink_new_flags_bulk_ctx(Blink_ctx ctx, const Sim_RH *handles,
+                              const unsigned int *flags, unsigned int count)
+{
+    WITH_CTX(ctx, Blink_new_flags_bulk(handles, flags, count));
+}
+
+void Blink_begin_update_ctx(Blink_ctx ctx)
+{
+    WITH_CTX(ctx, Blink_begin_update());
+}
+
+void Blink_end_update_ctx(Blink_ctx ctx)
+{
+    WITH_CTX(ctx, Blink_end_update());
+}
+
+void Blink_store_handle_ctx(Blink_ctx ctx, Blink_CH handle, Sim_RH key)
+{
+    WITH_CTX(ctx, Blink_store_handle(handle, key));
+}
+
+Blink_CH Blink_retrieve_handle_ctx(Blink_ctx ctx, Sim_RH key)
+{
+    Blink_CH rv;
+
+    WITH_CTX(ctx, rv = Blink_retrieve_handle(key));
+    return rv;
+}
+
+void Blink_sim_ctl_ctx(Blink_ctx ctx, unsigned int ctl)
+{
+    WITH_CTX(ctx, Blink_sim_ctl(ctl));
+}
+
+void Blink_set_history_ctx(Blink_ctx ctx, unsigned int depth)
+{
+    WITH_CTX(ctx, Blink_set_history(depth));
+}
+
+void Blink_set_cycle_ctx(Blink_ctx ctx, uint64_t cycle)
+{
+    WITH_CTX(ctx, Blink_set_cycle(cycle));
+}
+
+/* Recording, capture and watches. */
+
+int Blink_trace_ctx(Blink_ctx ctx, const char *path, int format)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_trace(path, format));
+    return rv;
+}
+
+void Blink_trace_stop_ctx(Blink_ctx ctx)
+{
+    WITH_CTX(ctx, Blink_trace_stop());
+}
+
+int Blink_arm_ctx(Blink_ctx ctx, const struct blink_capture *cap)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_arm(cap));
+    return rv;
+}
+
+int Blink_capture_state_ctx(Blink_ctx ctx)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_capture_state());
+    return rv;
+}
+
+int Blink_add_watch_ctx(Blink_ctx ctx, const struct blink_condition *cond)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_add_watch(cond));
+    return rv;
+}
+
+void Blink_remove_watch_ctx(Blink_ctx ctx, int watch)
+{
+    WITH_CTX(ctx, Blink_remove_watch(watch));
+}
+
+int Blink_watch_hit_ctx(Blink_ctx ctx)
+{
+    int rv;
+
+    WITH_CTX(ctx, rv = Blink_watch_hit());
+    return rv;
+}
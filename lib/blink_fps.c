@@ -20,5 +20,77 @@ struct blink_functs Blink_FPs = {
     F(retrieve_handle)
     F(poll)
     F(sim_ctl)
+    F(add_register_id)
+    F(new_value_id)
+    F(new_FP_id)
+    F(new_flags_id)
+    F(new_values)
+    F(new_flags_bulk)
+    F(begin_update)
+    F(end_update)
+    F(new_wide_value)
+    F(new_wide_flags)
+    F(new_wide_value_id)
+    F(new_wide_flags_id)
+    F(new_list)
+    F(set_history)
+    F(set_cycle)
+    F(trace)
+    F(trace_stop)
+    F(arm)
+    F(capture_state)
+    F(add_watch)
+    F(remove_watch)
+    F(watch_hit)
+    F(generation_ptr)
+    F(get_fd)
+    F(new_context)
+    F(use_context)
+    F(get_context)
+    F(set_push_wide)
+    F(set_push_batch)
+    F(free_context)
+    F(init_ctx)
+    F(run_control_ctx)
+    F(stopped_ctx)
+    F(poll_ctx)
+    F(get_fd_ctx)
+    F(set_push_wide_ctx)
+    F(set_push_batch_ctx)
+    F(new_row_ctx)
+    F(new_overlay_ctx)
+    F(add_to_container_ctx)
+    F(new_grid_ctx)
+    F(new_list_ctx)
+    F(add_register_ctx)
+    F(add_register_id_ctx)
+    F(change_overlay_ctx)
+    F(new_value_ctx)
+    F(new_FP_ctx)
+    F(new_flags_ctx)
+    F(new_strings_ctx)
+    F(new_wide_value_ctx)
+    F(new_wide_flags_ctx)
+    F(new_values_ctx)
+    F(new_flags_bulk_ctx)
+    F(begin_update_ctx)
+    F(end_update_ctx)
+    F(new_value_id_ctx)
+    F(new_FP_id_ctx)
+    F(new_flags_id_ctx)
+    F(new_wide_value_id_ctx)
+    F(new_wide_flags_id_ctx)
+    F(store_handle_ctx)
+    F(retrieve_handle_ctx)
+    F(sim_ctl_ctx)
+    F(set_history_ctx)
+    F(set_cycle_ctx)
+    F(trace_ctx)
+    F(trace_stop_ctx)
+    F(arm_ctx)
+    F(capture_state_ctx)
+    F(add_watch_ctx)
+    F(remove_watch_ctx)
+    F(watch_hit_ctx)
 };
     
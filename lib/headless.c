@@ -0,0 +1,152 @@
+/*
+ * Copyright 2024 Giles Atkinson
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* A replacement for panel.c that has no window and never starts Gtk.
+ * Linked with sim.c it gives a library for batch runs: registers are
+ * still recorded in the struct thing tree, but nothing is displayed and
+ * Blink_run_control() free-runs the simulation.
+ *
+ * The run is configured by environment variables:
+ *
+ *   BLINK_BURST        Cycles per burst (default 10000).
+ *   BLINK_BURST_TARGET If set, fast bursts are sized to take this
+ *                      many microseconds, starting from BLINK_BURST.
+ *   BLINK_CYCLES       Total cycles to run before calling sim_done()
+ *                      and exiting.  Zero or unset means no limit.
+ *
+ * The run also ends if the simulator calls Blink_stopped().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "sim.h"
+#include "no_gtk.h"
+#include "panel.h"
+
+#define DEFAULT_BURST 10000
+
+/* Get an unsigned number from the environment. */
+
+static guint64 env_value(const char *name, guint64 def)
+{
+    const char *text;
+    char       *end;
+    guint64     value;
+
+    text = getenv(name);
+    if (!text || !*text)
+        return def;
+    value = strtoull(text, &end, 0);
+    if (*end) {
+        fprintf(stderr, "Bad value \"%s\" for %s ignored.\n", text, name);
+        return def;
+    }
+    return value;
+}
+
+/* There is no UI thread, so cross-thread calls are made directly. */
+
+void Call_UI(GSourceFunc fn, gpointer data, gint UNUSED(priority))
+{
+    (*fn)(data);
+}
+
+/* Nothing is displayed. */
+
+void Wake_display(struct blink_ctx *UNUSED(ctx))
+{
+}
+
+/* Items are kept for their register structures, but not shown.
+ * Changed registers accumulate on Dirty_regs, but each appears only once.
+ */
+
+gboolean New_thing_call(gpointer UNUSED(data))
+{
+    return FALSE;
+}
+
+gboolean Display_burst(gpointer UNUSED(data))
+{
+    return FALSE;
+}
+
+gboolean Overlay_switch(gpointer UNUSED(data))
+{
+    return FALSE;
+}
+
+gboolean New_strings_call(gpointer UNUSED(data))
+{
+    return FALSE;
+}
+
+/* With nobody to restart it, a stopped simulation is finished. */
+
+void Blink_stopped(void)
+{
+    g_atomic_pointer_set(&User_modified_regs, EXIT_VALUE); // Exit next time.
+}
+
+gboolean Show_stopped(gpointer data)
+{
+    if (data) {
+        fprintf(stderr, "Stopped by watch %d at cycle %" G_GUINT64_FORMAT
+                ".\n", GPOINTER_TO_INT(data) - 1, Watch_time);
+    }
+    Blink_stopped();
+    return FALSE;
+}
+
+/* Set the run policy in place of building a window. */
+
+void Start_Panel(const char *UNUSED(title),
+                 const char **UNUSED(unit_strings), unsigned int initial_unit)
+{
+    guint64 burst;
+
+    burst = env_value("BLINK_BURST", DEFAULT_BURST);
+    if (burst == 0 || burst > G_MAXUINT)
+        burst = DEFAULT_BURST;
+    The_clock.run = 1;
+    The_clock.fast = 1;
+    The_clock.cycles_fast = (unsigned int)burst;
+    The_clock.cycles_slow = 1;
+    The_clock.cycles_sim = (unsigned int)burst;
+    The_clock.rate = 20;
+    The_clock.unit = initial_unit;
+    The_clock.unit_reg.handle = COMBO_HANDLE;
+    The_clock.unit_reg.nwords = 1;
+    The_clock.unit_reg.v.words = The_clock.unit_words;
+    The_clock.unit_reg.options = RO_STYLE_COMBO;
+    The_clock.unit_reg.clones = &The_clock.unit_reg;
+    The_clock.unit_reg.ctx = Ctx;
+    The_clock.cycle_limit = env_value("BLINK_CYCLES", 0);
+    The_clock.burst_target = (unsigned int)env_value("BLINK_BURST_TARGET", 0);
+    The_clock.auto_burst = (The_clock.burst_target != 0);
+}
+
+/* There is no display to release. */
+
+void Panel_free(void)
+{
+}
@@ -8,3 +8,4 @@ typedef void GtkToggleButton;
 typedef void GtkSpinButton;
 typedef void GtkComboBox;
 
+typedef void GtkAdjustment;
@@ -14,7 +14,6 @@
 #endif
 
 #define WIDTH        8          /* Default bit width. */
-#define BIT_KEY    "n"          /* Key for widget-associated items. */
 
 static GtkWidget *thing_to_widget(struct thing *thing, gboolean bare);
 
@@ -24,23 +23,138 @@ static GtkWidget *thing_to_widget(struct thing *thing, gboolean bare);
 
 #define ALIGNMENT 0.95
 
-/* Global data items. */
+/* Minimum time between display refreshes, in microseconds.  Zero means
+ * every frame.  May be set by environment variable BLINK_FPS.
+ */
+
+static gint64     Frame_interval;
+
+/* Each context is shown in its own window, and the UI thread selects
+ * the context before handling anything for a window.  The window's data
+ * are members of its panel_state, named by macros.
+ */
+
+struct panel_state {
+    GtkWidget          *window;
+    GtkWidget          *vbox;           /* Holds the clock and items. */
+    gint                ticking;        /* See frame_tick(). */
+    gint64              next_frame;
+    gboolean            closed;         /* The window has gone. */
+
+    /* The history scrubber.  When rewound, registers with history show
+     * their values at Rewind_time and other updates are not shown.
+     */
+
+    GtkWidget          *scrubber;
+    GtkAdjustment      *scrub_adj;
+    gboolean            scrub_setting;  /* Ignore value-changed. */
+    gboolean            rewound;
+    guint64             rewind_time;
+
+    /* Controls for triggered capture, shown once a capture is set up. */
+
+    GtkWidget          *capture_box;
+    GtkWidget          *capture_label;
+    int                 capture_shown;
+
+    /* Watches set from the panel, or the one that stopped the run. */
+
+    GtkWidget          *watch_label;
+
+    /* Registers with lamps showing activity, see show_reg(). */
+
+    struct reg        **glowing;
+    unsigned int        glowing_count, glowing_size;
+
+    /* All waveforms and scope plots, for redrawing. */
+
+    struct reg        **waves;
+    unsigned int        wave_count, wave_size;
+    guint64             waves_drawn;    /* Time at the right, as drawn. */
+    struct scope_view **views;
+    unsigned int        view_count, view_size;
+};
+
+#define Top_window (Ctx->panel->window)
+#define Vbox (Ctx->panel->vbox)
+#define Ticking (Ctx->panel->ticking)
+#define Scrubber (Ctx->panel->scrubber)
+#define Scrub_adj (Ctx->panel->scrub_adj)
+#define Scrub_setting (Ctx->panel->scrub_setting)
+#define Rewound (Ctx->panel->rewound)
+#define Rewind_time (Ctx->panel->rewind_time)
+#define Capture_box (Ctx->panel->capture_box)
+#define Capture_label (Ctx->panel->capture_label)
+#define Watch_label (Ctx->panel->watch_label)
+#define Glowing (Ctx->panel->glowing)
+#define Glowing_count (Ctx->panel->glowing_count)
+#define Glowing_size (Ctx->panel->glowing_size)
+#define Waves (Ctx->panel->waves)
+#define Wave_count (Ctx->panel->wave_count)
+#define Wave_size (Ctx->panel->wave_size)
+#define Views (Ctx->panel->views)
+#define View_count (Ctx->panel->view_count)
+#define View_size (Ctx->panel->view_size)
+
+/* Key for the context of a top-level window. */
+
+#define CTX_KEY "blink-ctx"
+
+/* Select the context shown in the window holding a widget. */
+
+static void select_ctx(GtkWidget *widget)
+{
+    struct blink_ctx *ctx;
+
+    if (!widget)
+        return;
+    ctx = g_object_get_data(G_OBJECT(gtk_widget_get_toplevel(widget)),
+                            CTX_KEY);
+    if (ctx)
+        Ctx = ctx;
+}
+
+/* Set when the UI thread has gone, after the main window closed. */
+
+static gint UI_gone;
 
-struct clock    The_clock;
+/* A call queued for the UI thread, with the context to select. */
 
-/* List of struct_regs with pending simulator updates - mutex locked. */
+struct ui_call {
+    GSourceFunc         fn;
+    gpointer            data;
+    struct blink_ctx   *ctx;
+};
 
-struct reg     *User_modified_regs;
+static gboolean ui_call(gpointer data)
+{
+    struct ui_call *cp;
 
-/* Locking for the above. */
+    cp = (struct ui_call *)data;
+    Ctx = cp->ctx;
+    if (Ctx->panel->closed)
+        return FALSE;                   /* Nothing left to show it. */
+    return (*cp->fn)(cp->data);
+}
 
-GMutex          Simulation_mutex;
+static void queue_call(struct blink_ctx *ctx, GSourceFunc fn, gpointer data,
+                       gint priority)
+{
+    struct ui_call *cp;
 
-/* To wake sleeping simulation thread. */
+    cp = g_new(struct ui_call, 1);
+    cp->fn = fn;
+    cp->data = data;
+    cp->ctx = ctx;
+    g_idle_add_full(priority, ui_call, cp, g_free);
+}
 
-GCond           Simulation_waker;
+/* Queue a function for the UI thread. */
 
-static GtkWidget *vbox1; /* FIX ME! */
+void Call_UI(GSourceFunc fn, gpointer data, gint priority)
+{
+    queue_call(Ctx, fn, data, priority);
+}
 
 /* Window delete event handler for top-level. */
 
@@ -50,159 +164,971 @@ static gboolean delete_event(GtkWidget *UNUSED(widget),
     return FALSE;       /* Requests window destruction. */
 }
 
-/* Force main loop and program exit. */
+/* Window destruction callback for top level.  The simulation is told to
+ * finish.  For the main context the program exits, so the main loop stops
+ * here, but the other windows' simulations just end.
+ */
+
+static void destroy_cb(GtkWidget *UNUSED(widget), gpointer dp)
+{
+    Ctx = (struct blink_ctx *)dp;
+    Ctx->panel->closed = TRUE;
+    g_atomic_int_set(&Ticking, TRUE);   /* Never wake it again. */
+    g_atomic_pointer_set(&User_modified_regs, EXIT_VALUE); // Inform simulator.
+    Count_change();
+    if (Ctx == &Main_ctx) {
+        g_atomic_int_set(&UI_gone, TRUE);
+        g_thread_exit(NULL);
+    }
+}
+
+/* Close the window, ending its simulation. */
 
 static void stop(void)
 {
+    gtk_widget_destroy(Top_window);
+}
 
-    g_mutex_lock(&Simulation_mutex);
-    User_modified_regs = EXIT_VALUE; // Inform simulator.
-    g_mutex_unlock(&Simulation_mutex);
-    g_thread_exit(NULL);
+/* Registers shown as individual bits are drawn as a single widget,
+ * with lamps in groups of 4, least significant on the right.  Wide
+ * registers use several lines, the lowest bits at the bottom.
+ * The lamps show the value and flags recorded in u.b.prev by set_reg().
+ */
+
+#define LAMP_BORDER     3       /* Space around lamp image. */
+#define LAMP_CELL       (LAMP_SIZE + 2 * LAMP_BORDER)
+#define LAMP_PITCH      (LAMP_CELL + 4)
+#define GROUP_PITCH     (4 * LAMP_PITCH + 8)
+#define LINE_PITCH      (LAMP_CELL + 6)
+#define LAMPS_PER_LINE  32
+
+static unsigned int lamp_columns(struct reg *this)
+{
+    return this->width < LAMPS_PER_LINE ? this->width : LAMPS_PER_LINE;
 }
 
-/* Window destruction callback for top level. */
+static unsigned int lamp_lines(struct reg *this)
+{
+    return (this->width + LAMPS_PER_LINE - 1) / LAMPS_PER_LINE;
+}
 
-static void destroy_cb(GtkWidget *UNUSED(widget), gpointer UNUSED(dp))
+/* Find the top-left corner of a lamp. */
+
+static void lamp_position(struct reg *this, unsigned int index,
+                          int *xp, int *yp)
 {
-    stop();
+    unsigned int col, line, columns;
+
+    columns = lamp_columns(this);
+    col = index % LAMPS_PER_LINE;
+    line = index / LAMPS_PER_LINE;
+    *xp = (columns - 1 - col) * LAMP_PITCH +
+          ((columns - 1) / 4 - col / 4) * (GROUP_PITCH - 4 * LAMP_PITCH);
+    *yp = (lamp_lines(this) - 1 - line) * LINE_PITCH;
 }
 
-/* Set a button's lamp. */
+/* Find the lamp at a point, returning -1 for none. */
 
-static void set_light(struct reg *this, int index)
+static int lamp_at(struct reg *this, int x, int y)
 {
-    int          colour_base;
-    GdkPixbuf   *pb;
-    GtkWidget   *child;
+    unsigned int col, line, lines, index;
+    int          right, top;
+
+    lines = lamp_lines(this);
+    if (x < 0 || y < 0 || y >= (int)(lines * LINE_PITCH) ||
+        y % LINE_PITCH >= LAMP_CELL)
+        return -1;
+    line = lines - 1 - y / LINE_PITCH;
+    lamp_position(this, 0, &right, &top);
+    right += LAMP_CELL - 1 - x;         /* Distance from right edge. */
+    if (right < 0 ||
+        (right % GROUP_PITCH) / LAMP_PITCH >= 4 ||
+        (right % GROUP_PITCH) % LAMP_PITCH >= LAMP_CELL)
+        return -1;
+    col = 4 * (right / GROUP_PITCH) + (right % GROUP_PITCH) / LAMP_PITCH;
+    index = line * LAMPS_PER_LINE + col;
+    if (col >= LAMPS_PER_LINE || index >= this->width)
+        return -1;
+    return index;
+}
 
-    if ((this->options & RO_ALT_COLOURS) && ((this->u_flags >> index) & 1))
-        colour_base = 2;
-    else
-        colour_base = 0;
-    pb = Lamps[colour_base + ((this->u_value >> index) & 1)];
-    child = gtk_button_get_image(GTK_BUTTON(this->u.b.buttons[index]));
-    gtk_image_set_from_pixbuf(GTK_IMAGE(child), pb);
+/* A lamp has changed: request that it be redrawn. */
+
+static void set_light(struct reg *this, unsigned int index)
+{
+    int x, y;
+
+    lamp_position(this, index, &x, &y);
+    gtk_widget_queue_draw_area(this->u.b.lamps, x, y, LAMP_CELL, LAMP_CELL);
 }
 
-/* Set a register's visible value. */
+/* Draw the lamps that intersect the area to be redrawn. */
 
-static void set_reg(struct reg *this)
+static gboolean draw_lamps(GtkWidget *widget, cairo_t *cr, gpointer data)
 {
-    unsigned int  i, changed, style;
-    int           index;
-    gchar         buff[64];
+    struct reg      *this;
+    GtkStyleContext *context;
+    GdkRectangle     clip;
+    GdkPixbuf       *pb;
+    unsigned int     i, n, bit, on, alt, active, sensitive;
+    int              x, y;
+
+    this = (struct reg *)data;
+    if (!gdk_cairo_get_clip_rectangle(cr, &clip))
+        return TRUE;
+    context = gtk_widget_get_style_context(widget);
+    gtk_style_context_save(context);
+    gtk_style_context_add_class(context, GTK_STYLE_CLASS_BUTTON);
+    for (i = 0; i < this->width; ++i) {
+        lamp_position(this, i, &x, &y);
+        if (x + LAMP_CELL <= clip.x || x >= clip.x + clip.width ||
+            y + LAMP_CELL <= clip.y || y >= clip.y + clip.height) {
+            continue;
+        }
+        n = i / WORD_BITS;
+        bit = i % WORD_BITS;
+        on = (this->u.b.prev[n] >> bit) & 1;
+        alt = (this->u.b.prev[this->nwords + n] >> bit) & 1;
+        active = (this->u.b.prev[2 * this->nwords + n] >> bit) & 1;
+        sensitive = !(this->options & RO_SENSITIVITY) || alt;
+        alt = (this->options & RO_ALT_COLOURS) && alt;
+        pb = Lamps[2 * alt + on];
+
+        gtk_render_background(context, cr, x, y, LAMP_CELL, LAMP_CELL);
+        gtk_render_frame(context, cr, x, y, LAMP_CELL, LAMP_CELL);
+        gdk_cairo_set_source_pixbuf(cr, pb, x + LAMP_BORDER, y + LAMP_BORDER);
+        if (sensitive && gtk_widget_is_sensitive(widget))
+            cairo_paint(cr);
+        else
+            cairo_paint_with_alpha(cr, 0.4);
+
+        /* A bit that changed during the frame is drawn half way between
+         * off and on: a lamp that is off glows faintly, and one that is
+         * on, but went off meanwhile, is dimmed.
+         */
+
+        if (active) {
+            gdk_cairo_set_source_pixbuf(cr, Lamps[2 * alt + !on],
+                                        x + LAMP_BORDER, y + LAMP_BORDER);
+            if (sensitive && gtk_widget_is_sensitive(widget))
+                cairo_paint_with_alpha(cr, 0.5);
+            else
+                cairo_paint_with_alpha(cr, 0.2);
+        }
+    }
+    gtk_style_context_restore(context);
+    return TRUE;
+}
+
+/* Bits that changed since the last frame, for the register being shown.
+ * Registers with lamps showing them, to be faded in the next frame,
+ * are in the window's Glowing.
+ */
+
+static guint64      *Activity;
+static unsigned int  Activity_words, Activity_size;
+
+/* Scratch space for register values, used only by the UI thread. */
+
+static guint64      *Scratch;
+static unsigned int  Scratch_size;
+static char         *Text;
+static unsigned int  Text_size;
+
+static guint64 *get_scratch(unsigned int nwords)
+{
+    if (nwords > Scratch_size) {
+        Scratch_size = nwords;
+        Scratch = g_renew(guint64, Scratch, Scratch_size);
+    }
+    return Scratch;
+}
+
+/* Format an integer register's value as hexadecimal or decimal text.
+ * The digits are generated from the least significant end, so any width
+ * is handled.  Decimal conversion divides by 10^9 in 32-bit halves.
+ */
+
+static const char *format_value(struct reg *this, const guint64 *past,
+                                gboolean hex)
+{
+    static const char  digit_chars[] = "0123456789ABCDEF";
+    unsigned int       n, i, k, len, size, top;
+    guint64           *words, rem, cur, hi, lo;
+    char              *p;
+
+    n = this->nwords;
+    words = get_scratch(n);
+    for (i = 0; i < n; ++i)
+        words[i] = past ? past[i] : get_word(reg_value(this) + i);
+
+    size = 20 * n + this->u_max_len + 1;
+    if (size > Text_size) {
+        Text_size = size;
+        Text = g_realloc(Text, Text_size);
+    }
+    p = Text + size - 1;
+    *p = '\0';
+
+    if (hex) {
+        for (len = n * 16; len > 1; --len) {
+            k = len - 1;
+            if ((words[k / 16] >> (4 * (k % 16))) & 0xf)
+                break;
+        }
+        if (len < this->u_max_len)
+            len = this->u_max_len;
+        for (k = 0; k < len; ++k) {
+            if (k < n * 16)
+                *--p = digit_chars[(words[k / 16] >> (4 * (k % 16))) & 0xf];
+            else
+                *--p = '0';
+        }
+        return p;
+    }
+
+    top = n;
+    do {
+        for (i = top, rem = 0; i-- > 0; ) {
+            cur = (rem << 32) | (words[i] >> 32);
+            hi = cur / 1000000000;
+            rem = cur % 1000000000;
+            cur = (rem << 32) | (words[i] & 0xffffffff);
+            lo = cur / 1000000000;
+            rem = cur % 1000000000;
+            words[i] = (hi << 32) | lo;
+        }
+        while (top > 0 && words[top - 1] == 0)
+            --top;
+        for (k = 0; k < 9; ++k) {
+            *--p = '0' + rem % 10;
+            rem /= 10;
+            if (top == 0 && rem == 0)
+                break;
+        }
+    } while (top > 0);
+    return p;
+}
+
+/* Parse hexadecimal or decimal text as a value of nwords words.
+ * Returns FALSE for bad text or a value that does not fit.
+ */
+
+static gboolean parse_value(const char *text, gboolean hex,
+                            guint64 *words, unsigned int nwords)
+{
+    unsigned int i, base, digit, count;
+    guint64      carry, hi, lo;
+
+    memset(words, 0, nwords * sizeof *words);
+    base = hex ? 16 : 10;
+    while (g_ascii_isspace(*text))
+        ++text;
+    if (hex && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+        text += 2;
+    for (count = 0; *text; ++text, ++count) {
+        if (hex) {
+            if (!g_ascii_isxdigit(*text))
+                break;
+            digit = g_ascii_xdigit_value(*text);
+        } else {
+            if (!g_ascii_isdigit(*text))
+                break;
+            digit = *text - '0';
+        }
+
+        /* Multiply by the base and add the digit, in 32-bit halves. */
+
+        carry = digit;
+        for (i = 0; i < nwords; ++i) {
+            lo = (words[i] & 0xffffffff) * base + carry;
+            hi = (words[i] >> 32) * base + (lo >> 32);
+            words[i] = (hi << 32) | (lo & 0xffffffff);
+            carry = hi >> 32;
+        }
+        if (carry)
+            return FALSE;
+    }
+    while (g_ascii_isspace(*text))
+        ++text;
+    return count > 0 && !*text;
+}
+
+/* Waveform display: a strip of WAVE_WIDTH pixel columns, the rightmost
+ * ending at the present or the rewind time.  History_runs() joins columns
+ * into runs, so drawing costs at most one shape per column.
+ * Single bits are drawn as a line at one of two levels, wider registers
+ * as a bus with the value in hexadecimal where there is room.
+ * A run where the value changed in every column is shaded.
+ */
+
+#define WAVE_WIDTH      256
+#define WAVE_HEIGHT     20
+#define WAVE_MARGIN     3       /* Above and below the traces. */
+#define WAVE_SLOPE      2       /* Width of bus value changes. */
+#define WAVE_MAX_SHIFT  48
+
+static struct wave_run   Wave_runs[WAVE_WIDTH];
+static guint64          *Wave_words;
+static unsigned int      Wave_words_size;
+
+/* The time at the right of the strips. */
+
+static guint64 wave_time(void)
+{
+    return Rewound ? Rewind_time : __atomic_load_n(&Sim_time, __ATOMIC_RELAXED);
+}
+
+/* Find a waveform's scale, fitting all history if not zoomed. */
+
+static unsigned int wave_shift(struct reg *this, guint64 time)
+{
+    guint64      span;
+    unsigned int shift;
+
+    if (this->u.w.shift >= 0)
+        return this->u.w.shift;
+    span = time - __atomic_load_n(&History_start, __ATOMIC_RELAXED);
+    for (shift = 0; shift < WAVE_MAX_SHIFT; ++shift) {
+        if ((span >> shift) < WAVE_WIDTH)
+            break;
+    }
+    return shift;
+}
+
+static gboolean draw_wave(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    struct reg           *this;
+    struct wave_run      *rp;
+    GtkStyleContext      *context;
+    GdkRGBA               colour;
+    cairo_text_extents_t  extents;
+    const char           *text;
+    const guint64        *value;
+    guint64               time;
+    unsigned int          vwords, nruns, i, edge;
+    double                x0, x1, top, bottom, y, prev_y;
+
+    this = (struct reg *)data;
+    Ctx = this->ctx;
+    context = gtk_widget_get_style_context(widget);
+    gtk_render_background(context, cr, 0, 0, WAVE_WIDTH, WAVE_HEIGHT);
+    gtk_render_frame(context, cr, 0, 0, WAVE_WIDTH, WAVE_HEIGHT);
+
+    vwords = this->head->nwords;
+    if (vwords > Wave_words_size) {
+        Wave_words_size = vwords;
+        Wave_words = g_renew(guint64, Wave_words, WAVE_WIDTH * vwords);
+    }
+    time = wave_time();
+    nruns = History_runs(this->head, time,
+                         (guint64)1 << wave_shift(this, time), WAVE_WIDTH,
+                         Wave_runs, Wave_words);
+
+    gtk_style_context_get_color(context, gtk_style_context_get_state(context),
+                                &colour);
+    gdk_cairo_set_source_rgba(cr, &colour);
+    cairo_set_line_width(cr, 1.0);
+    top = WAVE_MARGIN + 0.5;
+    bottom = WAVE_HEIGHT - WAVE_MARGIN - 0.5;
+    prev_y = 0.0;
+    for (i = 0; i < nruns; ++i) {
+        rp = Wave_runs + i;
+        if (rp->kind == WAVE_NONE)
+            continue;
+        x0 = rp->start;
+        x1 = rp->start + rp->length;
+        edge = i > 0 && Wave_runs[i - 1].kind != WAVE_NONE;
+        value = Wave_words + i * vwords;
+        if (rp->kind == WAVE_BUSY) {
+            cairo_stroke(cr);
+            cairo_rectangle(cr, x0, top, x1 - x0, bottom - top);
+            cairo_set_source_rgba(cr, colour.red, colour.green, colour.blue,
+                                  colour.alpha * 0.4);
+            cairo_fill(cr);
+            gdk_cairo_set_source_rgba(cr, &colour);
+            prev_y = 0.0;
+            continue;
+        }
+        if (this->width == 1) {
+            y = (value[0] & 1) ? top : bottom;
+            if (edge && prev_y != 0.0) {
+                cairo_move_to(cr, x0 + 0.5, prev_y);
+                cairo_line_to(cr, x0 + 0.5, y);
+            } else {
+                cairo_move_to(cr, x0, y);
+            }
+            cairo_line_to(cr, x1, y);
+            prev_y = y;
+            continue;
+        }
+
+        /* Bus: a crossing where the value changes. */
+
+        if (edge) {
+            cairo_move_to(cr, x0, top);
+            cairo_line_to(cr, x0 + WAVE_SLOPE, bottom);
+            cairo_move_to(cr, x0, bottom);
+            cairo_line_to(cr, x0 + WAVE_SLOPE, top);
+            x0 += WAVE_SLOPE;
+        }
+        if (x1 > x0) {
+            cairo_move_to(cr, x0, top);
+            cairo_line_to(cr, x1, top);
+            cairo_move_to(cr, x0, bottom);
+            cairo_line_to(cr, x1, bottom);
+            text = format_value(this, value, TRUE);
+            cairo_text_extents(cr, text, &extents);
+            if (extents.width + 2 * WAVE_SLOPE < x1 - x0) {
+                cairo_move_to(cr, x0 + WAVE_SLOPE,
+                              (WAVE_HEIGHT + extents.height) / 2);
+                cairo_show_text(cr, text);
+            }
+        }
+    }
+    cairo_stroke(cr);
+    return TRUE;
+}
+
+/* Scrolling over a waveform zooms in or out. */
+
+static gboolean wave_scroll(GtkWidget *widget, GdkEventScroll *event,
+                            gpointer data)
+{
+    struct reg *this;
+    int         shift;
+
+    this = (struct reg *)data;
+    Ctx = this->ctx;
+    shift = wave_shift(this, wave_time());
+    if (event->direction == GDK_SCROLL_UP ||
+        (event->direction == GDK_SCROLL_SMOOTH && event->delta_y < 0)) {
+        if (shift > 0)
+            --shift;
+    } else if (event->direction == GDK_SCROLL_DOWN ||
+               (event->direction == GDK_SCROLL_SMOOTH && event->delta_y > 0)) {
+        if (shift < WAVE_MAX_SHIFT)
+            ++shift;
+    } else {
+        return FALSE;
+    }
+    this->u.w.shift = shift;
+    gtk_widget_queue_draw(widget);
+    return TRUE;
+}
+
+/* A middle click on a waveform fits all history in the strip again. */
+
+static gboolean click_wave(GtkWidget *widget, GdkEventButton *event,
+                           gpointer data)
+{
+    struct reg *this;
+
+    this = (struct reg *)data;
+    if (event->type != GDK_BUTTON_PRESS || event->button != GDK_BUTTON_MIDDLE)
+        return FALSE;
+    this->u.w.shift = -1;
+    gtk_widget_queue_draw(widget);
+    return TRUE;
+}
+
+/* Time moves the waveforms, so redraw them all when it changes. */
+
+static void redraw_waves(void)
+{
+    guint64      time;
+    unsigned int i;
+
+    time = wave_time();
+    if (time == Ctx->panel->waves_drawn)
+        return;
+    Ctx->panel->waves_drawn = time;
+    for (i = 0; i < Wave_count; ++i)
+        gtk_widget_queue_draw(Waves[i]->u.w.area);
+}
+
+/* Scope plots of floating-point registers with option RO_SCOPE.  Each
+ * column shows the range of the samples it covers, found by
+ * Scope_columns() from the pyramid in scope.c, and is joined to the one
+ * before.  The view keeps the vertical scale last drawn, so that a click
+ * can set the trigger level.
+ */
+
+#define SCOPE_WIDTH     256
+#define SCOPE_HEIGHT    64
+#define SCOPE_MARGIN    2
+#define SCOPE_MAX_SHIFT 20
+
+struct scope_view {
+    struct reg         *reg;
+    GtkWidget          *area;
+    int                 shift;          /* Log2 samples per pixel, or -1. */
+    gboolean            triggered;      /* Trigger level set? */
+    double              trigger;
+    double              low, high;      /* Vertical scale as drawn. */
+    guint64             drawn;          /* Sample count when drawn. */
+};
+
+static double Scope_mins[SCOPE_WIDTH], Scope_maxs[SCOPE_WIDTH];
+
+/* Find a plot's scale, fitting all samples if not zoomed. */
+
+static unsigned int scope_shift(struct scope_view *view, guint64 count)
+{
+    unsigned int shift;
+
+    if (view->shift >= 0)
+        return view->shift;
+    if (count > view->reg->head->scope->depth)
+        count = view->reg->head->scope->depth;
+    for (shift = 0; shift < SCOPE_MAX_SHIFT; ++shift) {
+        if ((count >> shift) <= SCOPE_WIDTH)
+            break;
+    }
+    return shift;
+}
+
+/* Convert between values and vertical positions. */
+
+static double scope_y(struct scope_view *view, double value)
+{
+    return SCOPE_MARGIN + (SCOPE_HEIGHT - 2 * SCOPE_MARGIN) *
+                              (view->high - value) / (view->high - view->low);
+}
+
+static double scope_value(struct scope_view *view, double y)
+{
+    return view->high - (y - SCOPE_MARGIN) * (view->high - view->low) /
+                            (SCOPE_HEIGHT - 2 * SCOPE_MARGIN);
+}
+
+static gboolean draw_scope(GtkWidget *widget, cairo_t *cr, gpointer data)
+{
+    struct scope_view *view;
+    struct scope      *sp;
+    GtkStyleContext   *context;
+    GdkRGBA            colour;
+    guint64            count, end, half, n;
+    unsigned int       shift, c;
+    double             low, high, range, a, b, prev_min, prev_max;
+
+    view = (struct scope_view *)data;
+    sp = view->reg->head->scope;
+    context = gtk_widget_get_style_context(widget);
+    gtk_render_background(context, cr, 0, 0, SCOPE_WIDTH, SCOPE_HEIGHT);
+    gtk_render_frame(context, cr, 0, 0, SCOPE_WIDTH, SCOPE_HEIGHT);
+
+    /* With a trigger, hold the last rising crossing in the middle. */
+
+    count = Scope_count(sp);
+    view->drawn = count;
+    shift = scope_shift(view, count);
+    end = count;
+    if (view->triggered) {
+        half = (guint64)(SCOPE_WIDTH / 2) << shift;
+        if (count > half) {
+            n = Scope_trigger(sp, view->trigger, count - half);
+            if (n != SCOPE_NONE)
+                end = n + half;
+        }
+    }
+    if (!Scope_columns(sp, end, shift, SCOPE_WIDTH, Scope_mins, Scope_maxs))
+        return TRUE;
+
+    /* Scale to fit the samples shown and the trigger level. */
+
+    low = view->triggered ? view->trigger : INFINITY;
+    high = view->triggered ? view->trigger : -INFINITY;
+    for (c = 0; c < SCOPE_WIDTH; ++c) {
+        if (Scope_mins[c] < low)
+            low = Scope_mins[c];
+        if (Scope_maxs[c] > high)
+            high = Scope_maxs[c];
+    }
+    if (!isfinite(low) || !isfinite(high))
+        return TRUE;
+    range = high - low;
+    if (range == 0.0)
+        range = low != 0.0 ? fabs(low) : 1.0;
+    view->low = low - range / 20;
+    view->high = high + range / 20;
+
+    gtk_style_context_get_color(context, gtk_style_context_get_state(context),
+                                &colour);
+    if (view->triggered) {
+        cairo_set_source_rgba(cr, colour.red, colour.green, colour.blue,
+                              colour.alpha * 0.4);
+        cairo_rectangle(cr, 0, floor(scope_y(view, view->trigger)),
+                        SCOPE_WIDTH, 1);
+        cairo_rectangle(cr, SCOPE_WIDTH / 2, 0, 1, SCOPE_HEIGHT);
+        cairo_fill(cr);
+    }
+    gdk_cairo_set_source_rgba(cr, &colour);
+    prev_min = prev_max = NAN;
+    for (c = 0; c < SCOPE_WIDTH; ++c) {
+        a = Scope_mins[c];
+        b = Scope_maxs[c];
+        if (isnan(a)) {
+            prev_min = prev_max = NAN;
+            continue;
+        }
+
+        /* Reach the previous column, so that steps are joined. */
+
+        if (!isnan(prev_min)) {
+            a = MIN(a, prev_max);
+            b = MAX(b, prev_min);
+        }
+        prev_min = Scope_mins[c];
+        prev_max = Scope_maxs[c];
+        a = floor(scope_y(view, a));
+        b = floor(scope_y(view, b));
+        cairo_rectangle(cr, c, b, 1, a - b + 1);
+    }
+    cairo_fill(cr);
+    return TRUE;
+}
+
+/* Scrolling over a plot zooms in or out. */
+
+static gboolean scope_scroll(GtkWidget *widget, GdkEventScroll *event,
+                             gpointer data)
+{
+    struct scope_view *view;
+    int                shift;
+
+    view = (struct scope_view *)data;
+    shift = scope_shift(view, Scope_count(view->reg->head->scope));
+    if (event->direction == GDK_SCROLL_UP ||
+        (event->direction == GDK_SCROLL_SMOOTH && event->delta_y < 0)) {
+        if (shift > 0)
+            --shift;
+    } else if (event->direction == GDK_SCROLL_DOWN ||
+               (event->direction == GDK_SCROLL_SMOOTH && event->delta_y > 0)) {
+        if (shift < SCOPE_MAX_SHIFT)
+            ++shift;
+    } else {
+        return FALSE;
+    }
+    view->shift = shift;
+    gtk_widget_queue_draw(widget);
+    return TRUE;
+}
+
+/* Mouse buttons on a plot: set or clear the trigger level, or fit all. */
+
+static gboolean click_scope(GtkWidget *widget, GdkEventButton *event,
+                            gpointer data)
+{
+    struct scope_view *view;
+
+    view = (struct scope_view *)data;
+    if (event->type != GDK_BUTTON_PRESS)
+        return FALSE;
+    switch (event->button) {
+    case GDK_BUTTON_PRIMARY:
+        if (view->high <= view->low)
+            return FALSE;                       /* Nothing drawn yet. */
+        view->trigger = scope_value(view, event->y);
+        view->triggered = TRUE;
+        break;
+    case GDK_BUTTON_SECONDARY:
+        view->triggered = FALSE;
+        break;
+    case GDK_BUTTON_MIDDLE:
+        view->shift = -1;
+        break;
+    default:
+        return FALSE;
+    }
+    gtk_widget_queue_draw(widget);
+    return TRUE;
+}
+
+/* Redraw plots with new samples. */
+
+static void redraw_scopes(void)
+{
+    struct scope_view *view;
+    unsigned int       i;
+
+    for (i = 0; i < View_count; ++i) {
+        view = Views[i];
+        if (Scope_count(view->reg->head->scope) != view->drawn)
+            gtk_widget_queue_draw(view->area);
+    }
+}
+
+/* Find how a register is shown: listed registers are always text. */
+
+static unsigned int display_style(struct reg *this)
+{
+    unsigned int style;
 
     style = this->options & RO_STYLE_MASK;
+    if (!(this->options & RO_LISTED))
+        return style;
+    switch (style) {
+    case RO_STYLE_BITS:
+    case RO_STYLE_HEX:
+    case RO_STYLE_WAVE:
+        return RO_STYLE_HEX;
+    case RO_STYLE_FP:
+    case RO_STYLE_FP_SPIN:
+        return RO_STYLE_FP;
+    default:
+        return RO_STYLE_DECIMAL;
+    }
+}
+
+/* Set a register's visible value, from its history if "past" is not NULL.
+ * The simulator may change the value at any time, so each word is read once.
+ */
+
+static void show_reg(struct reg *this, const guint64 *past)
+{
+    unsigned int  n, bit, index, style, was_active;
+    guint64       value, flags, active, changed;
+    double        f_value;
+    int           combo_index;
+    const char   *text;
+    gchar         buff[64];
+
+    if ((this->options & RO_LISTED) && !this->u_entry)
+        return;                         /* Scrolled out of view. */
+    style = display_style(this);
     switch (style) {
     case RO_STYLE_BITS:
-        /* Set individual bits. */
-
-        /* Open bug: with the simavr/blink example program updating PORTD bits
-         * fails at high simulation speed.  Uncommenting thse lines fixes
-         * the Heisenbug.
-         *
-         * printf("Reg %s: old %#x new %#x\n",
-         *        this->name, this->u.b.prev_value, this->u_value);
+        /* Set individual bits, touching only lamps that changed.
+         * A bit may be set and cleared again between frames, as when
+         * the simavr/blink example program pulses PORTD bits at high
+         * simulation speed.  Such bits are in the activity and are shown
+         * as half-lit for a frame, so that no pulse is invisible.
          */
 
-        changed = this->u_value ^ this->u.b.prev_value;
-        if (this->options & RO_ALT_COLOURS)
-            changed |= this->u_flags ^ this->u.b.prev_flags;
-        for (i = 0; i < this->width; ++i, changed >>= 1) {
-            if (changed & 1)
-                set_light(this, i);
+        for (was_active = 0, n = 0; n < this->nwords; ++n) {
+            value = past ? past[n] : get_word(reg_value(this) + n);
+            flags = get_word(reg_flags(this) + n);
+            active = (!past && n < Activity_words) ? Activity[n] : 0;
+            changed = value ^ this->u.b.prev[n];
+            if (this->options & (RO_ALT_COLOURS | RO_SENSITIVITY))
+                changed |= flags ^ this->u.b.prev[this->nwords + n];
+            changed |= active ^ this->u.b.prev[2 * this->nwords + n];
+            was_active |= (this->u.b.prev[2 * this->nwords + n] != 0);
+            while (changed) {
+                bit = __builtin_ctzll(changed);
+                changed &= changed - 1;
+                index = n * WORD_BITS + bit;
+                if (index >= this->width)
+                    break;
+                set_light(this, index);
+            }
+            this->u.b.prev[n] = value;
+            this->u.b.prev[this->nwords + n] = flags;
+            this->u.b.prev[2 * this->nwords + n] = active;
+            if (active && !was_active) {
+                if (Glowing_count >= Glowing_size) {
+                    Glowing_size = Glowing_size ? 2 * Glowing_size : 16;
+                    Glowing = g_renew(struct reg *, Glowing, Glowing_size);
+                }
+                Glowing[Glowing_count++] = this;
+                was_active = 1;
+            }
         }
-        this->u.b.prev_value = this->u_value;
-        this->u.b.prev_flags = this->u_flags;
         return;
     case RO_STYLE_HEX:
-        snprintf(buff, sizeof buff, "%1$.*2$X",
-                 this->u_value, this->u_max_len);
+        text = format_value(this, past, TRUE);
         break;
     case RO_STYLE_DECIMAL:
     case RO_STYLE_SPIN:
-        snprintf(buff, sizeof buff, "%d", this->u_value);
+        text = format_value(this, past, FALSE);
         break;
     case RO_STYLE_COMBO:
-        if (this->u_value >= this->u_max_len)
-            index = -1;
+        value = past ? past[0] : get_word(reg_value(this));
+        if (value >= this->u_max_len)
+            combo_index = -1;
         else
-            index = (int)this->u_value;
-        gtk_combo_box_set_active((GtkComboBox *)this->u_entry, index);
+            combo_index = (int)value;
+        gtk_combo_box_set_active((GtkComboBox *)this->u_entry, combo_index);
         return;
         break;
+    case RO_STYLE_WAVE:
+        gtk_widget_queue_draw(this->u.w.area);    /* Drawn from history. */
+        return;
     case RO_STYLE_FP:
     case RO_STYLE_FP_SPIN:
-        snprintf(buff, sizeof buff, "%.*g", this->width, this->fp_value);
+        if ((this->options & (RO_SCOPE | RO_LISTED)) == RO_SCOPE)
+            return;                     /* Redrawn for new samples. */
+        if (past)
+            memcpy(&f_value, past, sizeof f_value);
+        else
+            f_value = get_fp(this);
+        snprintf(buff, sizeof buff, "%.*g", this->width, f_value);
+        text = buff;
         break;
     default:
         return;
     }
-    gtk_entry_set_text((GtkEntry *)this->u_entry, buff);
+    gtk_entry_set_text((GtkEntry *)this->u_entry, text);
+}
+
+static void set_reg(struct reg *this)
+{
+    show_reg(this, NULL);
+}
+
+/* Get a register's value at the rewind time, or NULL. */
+
+static const guint64 *past_value(struct reg *head)
+{
+    static guint64      *past;
+    static unsigned int  past_size;
+
+    if (!Rewound || !head->history)
+        return NULL;
+    if (head->history->stride > past_size) {
+        past_size = head->history->stride;
+        past = g_renew(guint64, past, past_size);
+    }
+    return History_at(head, Rewind_time, past) ? past : NULL;
+}
+
+/* Copy the value or flag words of a register to a clone. */
+
+static void copy_words(guint64 *to, unsigned int to_count,
+                       const guint64 *from, unsigned int from_count)
+{
+    unsigned int i;
+
+    for (i = 0; i < to_count; ++i)
+        set_word(to + i, i < from_count ? get_word(from + i) : 0);
 }
 
+/* Show a register's value and copy it to the clones.  The original's
+ * value is not written, as the simulator may be changing it.
+ */
+
 static void show_value(struct reg *rp)
 {
     struct reg   *cp;
-    unsigned int  is_fp, type, value;
+    unsigned int  i, is_fp, type;
     double        f_value;
 
     type = (rp->options & RO_STYLE_MASK);
     is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
-    if (is_fp)
-        f_value = rp->fp_value;
-    else
-        value = rp->u_value;
+    if (is_fp) {
+        f_value = get_fp(rp);
+    } else if (rp->head == rp) {
+        /* Take the bits changed by the simulator since the last frame. */
 
-    cp = rp;
-    do {
-        if (is_fp)
-            cp->fp_value = f_value;
-        else
-            cp->u_value = value;
+        if (rp->nwords > Activity_size) {
+            Activity_size = rp->nwords;
+            Activity = g_renew(guint64, Activity, Activity_size);
+        }
+        Activity_words = rp->nwords;
+        for (i = 0; i < rp->nwords; ++i) {
+            Activity[i] = __atomic_exchange_n(reg_activity(rp) + i, 0,
+                                              __ATOMIC_RELAXED);
+        }
+    }
+
+    set_reg(rp);
+    for (cp = rp->clones; cp != rp; cp = cp->clones) {
+        if (is_fp) {
+            set_fp(cp, f_value);
+        } else {
+            copy_words(reg_value(cp), cp->nwords,
+                       reg_value(rp), rp->nwords);
+        }
         set_reg(cp);
-        cp = cp->clones;
-    } while (cp != rp);
+    }
+    Activity_words = 0;
 }
 
 /* Send a changed register value to the simulator. */
 
 static void send_new_value(struct reg *this)
 {
-    g_mutex_lock(&Simulation_mutex);
-    if (this->state != User) {
-        if (this->state == Simulation) {
-            fprintf(stderr, "Overriding simulator value %#x for %s\n",
-                   this->u_value, this->name);
-        }
-        this->state = User;             /* Override simulation. */
-        this->chain = User_modified_regs;
-        User_modified_regs = this;
+    struct reg *head;
+
+    /* If the register is already queued, the simulation thread has yet
+     * to read the value, so there is nothing more to do.
+     */
+
+    if (g_atomic_int_get(&this->state) != User) {
+        if (g_atomic_int_get(&this->dirty) & DIRTY_VALUE)
+            fprintf(stderr, "Overriding simulator value for %s\n", this->name);
+        g_atomic_int_set(&this->state, User);   /* Override simulation. */
+        do {
+            head = g_atomic_pointer_get(&User_modified_regs);
+            this->chain = head;
+        } while (!g_atomic_pointer_compare_and_exchange(&User_modified_regs,
+                                                         head, this));
+        Count_change();
     }
-    g_mutex_unlock(&Simulation_mutex);
 
     /* Propagate new value to clones. */
 
     show_value(this);
 }
 
-/* Callback for clicking a register button. */
+/* Add or remove a watch for any change of a bit. */
 
-static void click_bit(GtkWidget *widget, gpointer data)
+static void toggle_bit_watch(struct reg *this, int index)
 {
-    struct reg          *this;
-    unsigned int         index;
+    struct blink_condition cond;
+    char                   buff[32];
+    int                    count;
+
+    if (index >= WORD_BITS)
+        return;                         /* Conditions test the low word. */
+    cond.id = this->head->id;
+    cond.kind = BLINK_COND_CHANGE;
+    cond.mask = (guint64)1 << index;
+    cond.match = 0;
+    cond.limit = 0;
+    count = Toggle_watch(&cond);
+    if (count)
+        snprintf(buff, sizeof buff, "Watches: %d", count);
+    else
+        buff[0] = '\0';
+    gtk_label_set_text(GTK_LABEL(Watch_label), buff);
+}
 
-    /* Find which button was pressed. */
+/* Callback for a mouse button over a register's lamps: flip the bit,
+ * or watch it for changes.
+ */
+
+static gboolean click_bit(GtkWidget *widget, GdkEventButton *event,
+                          gpointer data)
+{
+    struct reg *this;
+    int         index;
 
     this = (struct reg *)data;
-    index = (uintptr_t)g_object_get_data(G_OBJECT(widget), BIT_KEY);
-    if (index >= this->width)
-        return;                         /* Never taken. */
+    Ctx = this->ctx;
+    if (event->type != GDK_BUTTON_PRESS ||
+        (event->button != GDK_BUTTON_PRIMARY &&
+         event->button != GDK_BUTTON_SECONDARY)) {
+        return FALSE;
+    }
+    index = lamp_at(this, (int)event->x, (int)event->y);
+    if (index < 0)
+        return FALSE;
+    if (event->button == GDK_BUTTON_SECONDARY) {
+        toggle_bit_watch(this, index);
+        return TRUE;
+    }
+    if ((this->options & RO_SENSITIVITY) &&
+        !((this->u.b.prev[this->nwords + index / WORD_BITS] >>
+           (index % WORD_BITS)) & 1)) {
+        return FALSE;                   /* Insensitive bit. */
+    }
 
-    this->u_value ^= 1 << index;          /* Flip bit. */
+    __atomic_fetch_xor(reg_value(this) + index / WORD_BITS,        /* Flip. */
+                       (guint64)1 << (index % WORD_BITS), __ATOMIC_SEQ_CST);
     send_new_value(this);
+    return TRUE;
 }
 
 /* Callback for enter in a writeable text widget. */
@@ -211,178 +1137,407 @@ static void entry_activate(GtkWidget *widget, gpointer data)
 {
     struct reg   *this;
     const gchar  *text;
-    unsigned int  type, is_fp, value, count, eaten;
+    guint64      *words;
+    unsigned int  type, count, eaten, i;
     double        f_value;
 
     this = (struct reg *)data;
+    Ctx = this->ctx;
     text = gtk_entry_get_text((GtkEntry *)this->u_entry);
-    type = (this->options & RO_STYLE_MASK);
-    is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
-    switch (type) {
-    case RO_STYLE_HEX:
-        eaten = sscanf(text, "%x %n", &value, &count);
-        break;
-    case RO_STYLE_FP:
-    case RO_STYLE_FP_SPIN:
+    type = display_style(this);
+    if (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN) {
         eaten = sscanf(text, "%lg %n", &f_value, &count);
-        break;
-    default: // Decimal
-        eaten = sscanf(text, "%u %n", &value, &count);
-        break;
+        if (eaten != 1 || text[count])
+            goto bad;
+        if (get_fp(this) == f_value)
+            return;
+        set_fp(this, f_value);
+    } else {
+        words = get_scratch(this->nwords);
+        if (!parse_value(text, type == RO_STYLE_HEX, words, this->nwords))
+            goto bad;
+        for (i = 0; i < this->nwords; ++i) {
+            if (get_word(reg_value(this) + i) != words[i])
+                break;
+        }
+        if (i == this->nwords)
+            return;
+        for (i = 0; i < this->nwords; ++i)
+            set_word(reg_value(this) + i, words[i]);
+    }
+    send_new_value(this);
+    return;
+
+ bad:
+    /* Bad value.  Blank it and return. */
+
+    gtk_entry_set_text((GtkEntry *)this->u_entry, "");
+}
+
+/* Callback for new value in a spin button widget.  The adjustment is
+ * a double, so only the low 53 bits are useful.
+ */
+
+static void spin_reg_new_value(GtkWidget *widget, gpointer data)
+{
+    struct reg    *this;
+    GtkSpinButton *button;
+    guint64        value;
+
+    this = (struct reg *)data;
+    Ctx = this->ctx;
+    button = GTK_SPIN_BUTTON(this->u_entry);
+    value = (guint64)gtk_spin_button_get_value(button);
+    if (get_word(reg_value(this)) == value)
+        return;
+    set_word(reg_value(this), value);
+    send_new_value(this);
+}
+
+/* Callback for new value in a spin button widget. */
+
+static void spin_reg_new_fp_value(GtkWidget *widget, gpointer data)
+{
+    struct reg    *this;
+    GtkSpinButton *button;
+    double         value;
+
+    this = (struct reg *)data;
+    Ctx = this->ctx;
+    button = GTK_SPIN_BUTTON(this->u_entry);
+    value = gtk_spin_button_get_value(button);
+    if (get_fp(this) == value)
+        return;
+    set_fp(this, value);
+    send_new_value(this);
+}
+
+/* Callback for new combo-box selection. */
+
+static void combo_changed(GtkWidget *widget, gpointer data)
+{
+    struct reg   *this;
+    GtkComboBox  *combo;
+    guint64       value;
+
+    this = (struct reg *)data;
+    Ctx = this->ctx;
+    combo = GTK_COMBO_BOX(this->u_entry);
+    value = (unsigned int)gtk_combo_box_get_active(combo);
+    if (get_word(reg_value(this)) == value)
+        return;
+    set_word(reg_value(this), value);
+    send_new_value(this);
+}
+
+/* Show new display flags from the simulation. */
+
+static void show_flags(struct reg *rp)
+{
+    struct reg   *cp;
+
+    cp = rp;
+    do {
+        if (cp != rp) {
+            copy_words(reg_flags(cp), cp->nwords,
+                       reg_flags(rp), rp->nwords);
+        }
+        set_reg(cp);
+        cp = cp->clones;
+    } while (cp != rp);
+}
+
+/* Show everything the simulation changed since the last frame, so that
+ * each register is redrawn at most once per frame.  The whole list
+ * is taken at once and each entry's dirty bits are cleared only
+ * after its link is read, as it may then be listed again.
+ */
+
+static void refresh_regs(void)
+{
+    struct reg   *rp, *next;
+    unsigned int  i, n, bit, dirty;
+    guint64      *active;
+
+    /* Fade lamps that showed activity in the last frame.  They are lit
+     * again below if there was more.
+     */
+
+    for (i = 0; i < Glowing_count; ++i) {
+        rp = Glowing[i];
+        active = rp->u.b.prev + 2 * rp->nwords;
+        for (n = 0; n < rp->nwords; ++n) {
+            while (active[n]) {
+                bit = n * WORD_BITS + __builtin_ctzll(active[n]);
+                active[n] &= active[n] - 1;
+                if (bit < rp->width)
+                    set_light(rp, bit);
+            }
+        }
+    }
+    Glowing_count = 0;
+
+    do {
+        rp = g_atomic_pointer_get(&Dirty_regs);
+    } while (!g_atomic_pointer_compare_and_exchange(&Dirty_regs, rp, NULL));
+
+    for (; rp; rp = next) {
+        next = rp->dirty_chain;
+        dirty = g_atomic_int_and(&rp->dirty, 0);
+        if (Rewound)
+            continue;                   /* Shown by show_all() later. */
+        if (g_atomic_int_get(&rp->state) == User)
+            continue;                   /* Overridden by user. */
+        if (dirty & DIRTY_VALUE)
+            show_value(rp);
+        if (dirty & DIRTY_FLAGS)
+            show_flags(rp);
+    }
+}
+
+/* Show registers with history as they were at Rewind_time. */
+
+static void show_past(void)
+{
+    struct reg     **table, *rp, *cp;
+    const guint64   *past;
+    unsigned int     count, i;
+
+    table = Register_table(&count);
+    for (i = 0; i < count; ++i) {
+        rp = table[i];
+        past = past_value(rp);
+        if (!past)
+            continue;
+        cp = rp;
+        do {
+            show_reg(cp, past);
+            cp = cp->clones;
+        } while (cp != rp);
     }
-    if (eaten != 1 || text[count]) {
-        /* Bad value.  Blank it and return. */
+}
 
-        gtk_entry_set_text((GtkEntry *)this->u_entry, "");
-        return;
-    }
+/* Show the current values of all registers, after rewinding. */
 
-    if (is_fp) {
-        if (this->fp_value == f_value)
-            return;
-        this->fp_value = f_value;
-    } else {
-        if (this->u_value == value)
-            return;
-        this->u_value = value;
+static void show_all(void)
+{
+    struct reg   **table;
+    unsigned int   count, i;
+
+    table = Register_table(&count);
+    for (i = 0; i < count; ++i) {
+        if (g_atomic_int_get(&table[i]->state) != User)
+            show_value(table[i]);
     }
-    send_new_value(this);
 }
 
-/* Callback for new value in a spin button widget. */
+/* Keep the scrubber's range up to date, and follow the current
+ * time unless rewound.
+ */
 
-static void spin_reg_new_value(GtkWidget *widget, gpointer data)
+static void update_scrubber(void)
 {
-    struct reg    *this;
-    GtkSpinButton *button;
-    unsigned int   value;
+    guint64 now, start;
 
-    this = (struct reg *)data;
-    button = GTK_SPIN_BUTTON(this->u_entry);
-    value = gtk_spin_button_get_value_as_int(button);
-    if (this->u_value == value)
+    if (!g_atomic_int_get(&History_begun))
         return;
-    this->u_value = value;
-    send_new_value(this);
+    if (!gtk_widget_get_visible(Scrubber))
+        gtk_widget_show(Scrubber);
+    now = __atomic_load_n(&Sim_time, __ATOMIC_RELAXED);
+    start = __atomic_load_n(&History_start, __ATOMIC_RELAXED);
+    Scrub_setting = TRUE;
+    gtk_adjustment_configure(Scrub_adj, Rewound ? Rewind_time : now,
+                             start, now, 1.0, (now - start) / 20.0, 0.0);
+    Scrub_setting = FALSE;
 }
 
-/* Callback for new value in a spin button widget. */
+/* Callback for a move of the scrubber.  The right end is the present. */
 
-static void spin_reg_new_fp_value(GtkWidget *widget, gpointer data)
+static void scrub_moved(GtkAdjustment *adj, gpointer data)
 {
-    struct reg    *this;
-    GtkSpinButton *button;
-    double         value;
+    double value;
 
-    this = (struct reg *)data;
-    button = GTK_SPIN_BUTTON(this->u_entry);
-    value = gtk_spin_button_get_value(button);
-    if (this->fp_value == value)
+    Ctx = (struct blink_ctx *)data;
+    if (Scrub_setting)
         return;
-    this->fp_value = value;
-    send_new_value(this);
+    value = gtk_adjustment_get_value(adj);
+    if (value >= gtk_adjustment_get_upper(adj)) {
+        if (Rewound) {
+            Rewound = FALSE;
+            show_all();
+        }
+        return;
+    }
+    Rewound = TRUE;
+    Rewind_time = (guint64)value;
+    show_past();
 }
 
-/* Callback for new combo-box selection. */
+/* Show the state of a triggered capture. */
 
-static void combo_changed(GtkWidget *widget, gpointer data)
+static void update_capture(void)
 {
-    struct reg   *this;
-    GtkComboBox  *combo;
-    unsigned int  value;
+    static const char * const labels[] = {"", "Armed", "Triggered",
+                                          "Captured"};
+    int                       state;
 
-    this = (struct reg *)data;
-    combo = GTK_COMBO_BOX(this->u_entry);
-    value = gtk_combo_box_get_active(combo);
-    if (this->u_value == value)
+    state = g_atomic_int_get(&Capture_state);
+    if (state == Ctx->panel->capture_shown)
         return;
-    this->u_value = value;
-    send_new_value(this);
+    Ctx->panel->capture_shown = state;
+    gtk_label_set_text(GTK_LABEL(Capture_label), labels[state]);
+    gtk_widget_show(Capture_box);
 }
 
-/* This function is called when the simulation has new values to display. */
+/* Frame clock callback for the top level, limited to Frame_interval.
+ * It is removed while nothing runs or changes, so that an idle panel
+ * does not wake at every frame, and added again by start_ticks().
+ * Ticking is set while it is installed.  The simulation thread reads it
+ * after listing a register, and the UI clears it before a last look at
+ * the list, so one of them always sees the other.
+ */
 
-gboolean Simulation_call(gpointer data)
+static gboolean frame_tick(GtkWidget *UNUSED(widget), GdkFrameClock *clock,
+                           gpointer data)
 {
-    struct reg   *rp;
-
-    rp = (struct reg *)data;
-    if (!rp)
-        return FALSE;
-    g_mutex_lock(&Simulation_mutex);
-    if (rp->state == Simulation) {
-        rp->state = Valid;
-        show_value(rp);
-    } else {
-        fprintf(stderr, "In Simulation_call for %s but state %d\n",
-                rp->name, rp->state);
+    gint64 now;
+
+    Ctx = (struct blink_ctx *)data;
+    now = gdk_frame_clock_get_frame_time(clock);
+    if (The_clock.turbo && The_clock.run)
+        return G_SOURCE_CONTINUE;       /* Dirty registers wait for the end. */
+    if (now >= Ctx->panel->next_frame) {
+        Ctx->panel->next_frame = now + Frame_interval;
+        refresh_regs();
+        update_scrubber();
+        redraw_waves();
+        redraw_scopes();
+        update_capture();
+        if (The_clock.auto_burst && The_clock.fast && !The_clock.sim_ctl &&
+            !gtk_widget_has_focus(GTK_WIDGET(The_clock.burst))) {
+            Display_burst(NULL);        /* Show the current size. */
+        }
+        if (!The_clock.run && !The_clock.sim_ctl && Glowing_count == 0) {
+            g_atomic_int_set(&Ticking, FALSE);
+            if (!g_atomic_pointer_get(&Dirty_regs))
+                return G_SOURCE_REMOVE;
+            g_atomic_int_set(&Ticking, TRUE);
+        }
     }
-    g_mutex_unlock(&Simulation_mutex);
-    return FALSE;       /* Tell Glib loop we are finished. */
+    return G_SOURCE_CONTINUE;
 }
 
-/* This function is called when the simulation has new display flags. */
-
-gboolean Flag_call(gpointer data)
+static gboolean start_ticks(gpointer UNUSED(data))
 {
-    struct reg   *rp, *cp;
-    unsigned int  value;
-    unsigned int  bits, i;
-
-    rp = (struct reg *)data;
-    if (!rp)
-        return FALSE;
-    g_mutex_lock(&Simulation_mutex);
-    if (rp->state == Simulation) {
-        rp->state = Valid;
-        cp = rp;
-        value = rp->u_flags;
-        do {
-            cp->u_flags = value;
-            set_reg(cp);
-            if (cp->options & RO_SENSITIVITY) {
-                for (i = 0, bits = 1; i < cp->width; ++i, bits <<= 1) {
-                    gtk_widget_set_sensitive(cp->u.b.buttons[i],
-                                             (bits & value) != 0);
-                }
-            }
-            cp = cp->clones;
-        } while (cp != rp);
-    } else {
-        fprintf(stderr, "In Flag_call for %s but state %d\n",
-                rp->name, rp->state);
+    if (!g_atomic_int_get(&Ticking)) {
+        g_atomic_int_set(&Ticking, TRUE);
+        gtk_widget_add_tick_callback(Top_window, frame_tick, Ctx, NULL);
     }
-    g_mutex_unlock(&Simulation_mutex);
-    return FALSE;       /* Tell Glib loop we are finished. */
+    return FALSE;
 }
 
-/* Simulator stopped, probably on request. */
-
-void Blink_stopped(void)
+void Wake_display(struct blink_ctx *ctx)
 {
-    gtk_toggle_button_set_active(The_clock.run_button, FALSE);
+    if (!g_atomic_int_get(&ctx->panel->ticking))
+        queue_call(ctx, start_ticks, NULL, G_PRIORITY_DEFAULT);
 }
 
 /* Something changed, wake the simulation thread. */
 
 static void wake_simulation(void)
 {
+    start_ticks(NULL);
+    Count_change();
     g_cond_signal(&Simulation_waker);
 }
 
-static void click_toggle(GtkWidget *UNUSED(widget), gpointer data)
+static void click_toggle(GtkWidget *widget, gpointer data)
 {
     unsigned int        *var;
 
+    select_ctx(widget);
     var = (unsigned int *)data;
     *var ^= 1;
     wake_simulation();
 }
 
-static void click_go(GtkWidget *UNUSED(widget), gpointer data)
+/* The Run button: stopping also ends a turbo run. */
+
+static void click_run(GtkWidget *widget, gpointer data)
+{
+    select_ctx(widget);
+    if (!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)))
+        The_clock.turbo = 0;
+    click_toggle(widget, data);
+}
+
+/* Enter in the "Run to" field: run at full speed without display updates
+ * until the simulated time reaches the cycle given.
+ */
+
+static void run_to(GtkWidget *widget, gpointer UNUSED(data))
+{
+    const char *text;
+    char       *end;
+    guint64     target;
+
+    select_ctx(widget);
+    text = gtk_entry_get_text(GTK_ENTRY(widget));
+    target = g_ascii_strtoull(text, &end, 0);
+    if (end == text || *end ||
+        target <= __atomic_load_n(&Sim_time, __ATOMIC_RELAXED)) {
+        gtk_widget_error_bell(widget);
+        return;
+    }
+    The_clock.target = target;
+    The_clock.turbo = 1;
+    if (gtk_toggle_button_get_active(The_clock.run_button))
+        wake_simulation();
+    else
+        gtk_toggle_button_set_active(The_clock.run_button, TRUE);
+}
+
+/* The simulation thread has stopped the run: release the button
+ * without toggling The_clock.run again.  Any turbo run has ended too,
+ * so the display resumes.
+ */
+
+gboolean Show_stopped(gpointer data)
+{
+    char buff[64];
+    int  watch;
+
+    The_clock.turbo = 0;
+    g_signal_handlers_block_by_func(The_clock.run_button, click_run,
+                                    &The_clock.run);
+    gtk_toggle_button_set_active(The_clock.run_button, FALSE);
+    g_signal_handlers_unblock_by_func(The_clock.run_button, click_run,
+                                      &The_clock.run);
+    watch = GPOINTER_TO_INT(data) - 1;
+    if (watch >= 0) {
+        snprintf(buff, sizeof buff,
+                 "Watch %d at %" G_GUINT64_FORMAT, watch, Watch_time);
+        gtk_label_set_text(GTK_LABEL(Watch_label), buff);
+    }
+    return FALSE;
+}
+
+/* Simulator stopped, probably on request.  This may be called by the
+ * simulation thread, so the button is updated by the UI thread.
+ */
+
+void Blink_stopped(void)
+{
+    The_clock.run = 0;
+    The_clock.turbo = 0;
+    Call_UI(Show_stopped, NULL, G_PRIORITY_DEFAULT);
+}
+
+static void click_go(GtkWidget *widget, gpointer data)
 {
     struct clock       *clock_p;
 
+    select_ctx(widget);
     clock_p = (struct clock *)data;
     clock_p->go = 1;
     wake_simulation();
@@ -392,19 +1547,22 @@ static void click_fast(GtkWidget *widget, gpointer data)
 {
     struct clock  *clock_p;
 
+    select_ctx(widget);
     clock_p = (struct clock *)data;
     clock_p->fast = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
 
     if (clock_p->fast && clock_p->cycles_fast == 0)
         clock_p->cycles_fast = clock_p->cycles_slow;
     Display_burst(NULL);
+    wake_simulation();
 }
 
 /* Key press callback for top level. */
 
-static gboolean key_cb(GtkWidget *UNUSED(widget), GdkEventKey *event,
+static gboolean key_cb(GtkWidget *widget, GdkEventKey *event,
                        gpointer data)
 {
+    select_ctx(widget);
     switch (event->keyval) {
     case GDK_KEY_f:
     case GDK_KEY_F:
@@ -420,7 +1578,8 @@ static gboolean key_cb(GtkWidget *UNUSED(widget), GdkEventKey *event,
         break;
     case GDK_KEY_r:
     case GDK_KEY_R:
-        click_toggle(NULL, &The_clock.run);
+        gtk_toggle_button_set_active(The_clock.run_button,
+                        !gtk_toggle_button_get_active(The_clock.run_button));
         break;
     default:
         return FALSE;
@@ -428,9 +1587,18 @@ static gboolean key_cb(GtkWidget *UNUSED(widget), GdkEventKey *event,
     return TRUE;
 }
 
+/* Arm the last capture again, next time the simulation runs. */
+
+static void click_arm(GtkWidget *widget, gpointer UNUSED(data))
+{
+    select_ctx(widget);
+    g_atomic_int_set(&Capture_rearm, TRUE);
+}
+
 #ifdef QUIT_BUTTON
-static void do_quit(GtkWidget *UNUSED(widget), gpointer UNUSED(data))
+static void do_quit(GtkWidget *widget, gpointer UNUSED(data))
 {
+    select_ctx(widget);
     stop();
 }
 #endif
@@ -441,13 +1609,14 @@ static void unit_changed(GtkWidget *widget, gpointer data)
 {
     unsigned int unit;
 
+    select_ctx(widget);
     unit = gtk_combo_box_get_active(The_clock.combo);
     if (unit != The_clock.unit) {
         The_clock.unit = unit;
 
         /* Send the new value as a dummy register change. */
 
-        The_clock.unit_reg.u_value = unit;
+        set_word(reg_value(&The_clock.unit_reg), unit);
         send_new_value(&The_clock.unit_reg);
     }
 }
@@ -456,9 +1625,12 @@ static void unit_changed(GtkWidget *widget, gpointer data)
 
 static void cycles_new_value(GtkWidget *spin, void *param)
 {
-    gint           new;
+    unsigned int   new;
 
-    new = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+    /* The value may exceed G_MAXINT. */
+
+    select_ctx(spin);
+    new = (unsigned int)gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin));
     if (The_clock.sim_ctl)
         The_clock.cycles_sim = new;
     else if (The_clock.fast)
@@ -472,18 +1644,20 @@ static void cycles_new_value(GtkWidget *spin, void *param)
 
 static void spin_new_value(GtkSpinButton *spin, unsigned int *var)
 {
-    *var = gtk_spin_button_get_value_as_int(spin);
+    select_ctx(GTK_WIDGET(spin));
+    *var = (unsigned int)gtk_spin_button_get_value(spin);
     wake_simulation();
 }
 
-/* Change the displayed burst value when the run mode changes.
- * Called by gtk_main() as an idle-time function.
+/* Change the displayed burst value when the run mode or size changes.
+ * Called by gtk_main() as an idle-time function.  The adjustment is set
+ * only if the value differs, without calling cycles_new_value().
  */
 
 gboolean Display_burst(gpointer data)
 {
+    GtkAdjustment *adj;
     unsigned int   val;
-    gchar          buff[32];
 
     if (The_clock.sim_ctl)
         val = The_clock.cycles_sim;
@@ -491,8 +1665,14 @@ gboolean Display_burst(gpointer data)
         val = The_clock.cycles_fast;
     else
         val = The_clock.cycles_slow;
-    snprintf(buff, sizeof buff, "%u", val);
-    gtk_entry_set_text(GTK_ENTRY(The_clock.burst), buff);
+    adj = gtk_spin_button_get_adjustment(The_clock.burst);
+    if ((unsigned int)gtk_adjustment_get_value(adj) != val) {
+        g_signal_handlers_block_by_func(The_clock.burst, cycles_new_value,
+                                        &The_clock.cycles_slow);
+        gtk_adjustment_set_value(adj, val);
+        g_signal_handlers_unblock_by_func(The_clock.burst, cycles_new_value,
+                                          &The_clock.cycles_slow);
+    }
     return FALSE;       /* Tell Glib loop we are finished. */
 }
 
@@ -541,6 +1721,23 @@ gboolean New_strings_call(gpointer data)
 
 /* End of run-time code, start of simulator-side setup functions. */
 
+/* Find the longest text for a register value in the given style. */
+
+static unsigned int text_length(struct reg *this, unsigned int style)
+{
+    switch (style) {
+    case RO_STYLE_HEX:
+        return (this->width + 3) >> 2;
+    case RO_STYLE_FP:
+    case RO_STYLE_FP_SPIN:
+        return this->width + 7; // 2 signs, point, e, 3digits
+    case RO_STYLE_COMBO:
+        return 0;
+    default: // Decimal
+        return (unsigned int)(this->width * M_LN2 / M_LN10) + 1;
+    }
+}
+
 /* Create a new text entry widget or spin button to display a register. */
 
 static GtkWidget *raw_reg_entry_new(struct reg *this)
@@ -550,23 +1747,7 @@ static GtkWidget *raw_reg_entry_new(struct reg *this)
     unsigned int   max_len, type;
 
     type = this->options & RO_STYLE_MASK;
-    switch (type) {
-    case RO_STYLE_HEX:
-        max_len = (this->width + 3) >> 2;
-        break;
-    case RO_STYLE_FP:
-    case RO_STYLE_FP_SPIN:
-        max_len = this->width + 7; // 2 signs, point, e, 3digits
-        break;
-    case RO_STYLE_COMBO:
-        max_len = 0;
-        break;
-    default: // Decimal
-        max_len = (this->width + 2) / 3;
-        while (pow(10.0, max_len - 1) > pow(2.0, this->width) - 1)
-            --max_len;
-        break;
-    }
+    max_len = text_length(this, type);
     this->u_max_len = max_len;
     ++max_len;          // Allow for slight misalignment.
 
@@ -614,56 +1795,104 @@ static GtkWidget *raw_reg_entry_new(struct reg *this)
     return entry;
 }
 
+/* Create a waveform strip for a register. */
+
+static GtkWidget *raw_reg_wave_new(struct reg *this)
+{
+    GtkWidget *area;
+
+    area = gtk_drawing_area_new();
+    this->u.w.area = area;
+    gtk_widget_set_size_request(area, WAVE_WIDTH, WAVE_HEIGHT);
+    gtk_widget_set_halign(area, GTK_ALIGN_END);
+    gtk_widget_set_valign(area, GTK_ALIGN_CENTER);
+    gtk_style_context_add_class(gtk_widget_get_style_context(area),
+                                GTK_STYLE_CLASS_VIEW);
+    gtk_widget_add_events(area, GDK_BUTTON_PRESS_MASK | GDK_SCROLL_MASK);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_wave), this);
+    g_signal_connect(area, "scroll-event", G_CALLBACK(wave_scroll), this);
+    g_signal_connect(area, "button-press-event", G_CALLBACK(click_wave), this);
+    gtk_widget_show(area);
+
+    if (Wave_count == Wave_size) {
+        Wave_size = 2 * Wave_size + 16;
+        Waves = g_renew(struct reg *, Waves, Wave_size);
+    }
+    Waves[Wave_count++] = this;
+    return area;
+}
+
+/* Create a scope plot for a floating-point register. */
+
+static GtkWidget *raw_reg_scope_new(struct reg *this)
+{
+    struct scope_view *view;
+    GtkWidget         *area;
+
+    area = gtk_drawing_area_new();
+    view = g_new0(struct scope_view, 1);
+    view->reg = this;
+    view->area = area;
+    view->shift = -1;
+    this->u.s.view = view;
+    g_object_set_data_full(G_OBJECT(area), "view", view, g_free);
+    gtk_widget_set_size_request(area, SCOPE_WIDTH, SCOPE_HEIGHT);
+    gtk_widget_set_halign(area, GTK_ALIGN_END);
+    gtk_widget_set_valign(area, GTK_ALIGN_CENTER);
+    gtk_style_context_add_class(gtk_widget_get_style_context(area),
+                                GTK_STYLE_CLASS_VIEW);
+    gtk_widget_add_events(area, GDK_BUTTON_PRESS_MASK | GDK_SCROLL_MASK);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_scope), view);
+    g_signal_connect(area, "scroll-event", G_CALLBACK(scope_scroll), view);
+    g_signal_connect(area, "button-press-event",
+                     G_CALLBACK(click_scope), view);
+    gtk_widget_show(area);
+
+    if (View_count == View_size) {
+        View_size = 2 * View_size + 16;
+        Views = g_renew(struct scope_view *, Views, View_size);
+    }
+    Views[View_count++] = view;
+    return area;
+}
+
 /* Create the guts of a visible register with individual bits. */
 
 static GtkWidget *raw_reg_new(struct reg *this)
 {
-    GtkWidget    *hbox, *ibox, *but;
-    unsigned int  i;
-    int           j;
+    GtkWidget    *area;
+    unsigned int  columns;
 
+    if ((this->options & RO_STYLE_MASK) == RO_STYLE_WAVE)
+        return raw_reg_wave_new(this);
+    if (this->options & RO_SCOPE)
+        return raw_reg_scope_new(this);
     if (this->options & RO_STYLE_MASK) {
         /* For now assume a text entry widget. */
 
         return raw_reg_entry_new(this);
     }
-    hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
-
-    /* Make a row of buttons, in groups of 4. */
-
-    for (i = 0; i < this->width; ) {
-        ibox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
-        gtk_box_pack_end(GTK_BOX(hbox), ibox, FALSE, FALSE, 0);
-
-        /* Make a group of 4 buttons. */
-
-        for (j = 0; j < 4; ++j, ++i) {
-            if (i >= this->width)
-                break;
-
-            but = gtk_button_new();
-            if (this->options & RO_INSENSITIVE)
-                gtk_widget_set_sensitive(but, FALSE);
-            this->u.b.buttons[i] = but;
 
-            gtk_box_pack_end(GTK_BOX(ibox), but, FALSE, FALSE, 0);
-            gtk_widget_show(but);
-
-            /* Store the current bit index on the button, to be used by
-             * the signal's callback function.
-             */
-
-            g_object_set_data(G_OBJECT(but), BIT_KEY, (gpointer)(intptr_t)i);
-            g_signal_connect(but, "clicked", G_CALLBACK(click_bit), this);
-            gtk_button_set_image(GTK_BUTTON(but),
-                                 gtk_image_new_from_pixbuf(Lamps[BLUE]));
-            set_light(this, i);
-        }
-        gtk_widget_show(ibox);
-    }
-    gtk_widget_show(hbox);
+    /* One widget draws all the lamps. */
+
+    area = gtk_drawing_area_new();
+    this->u.b.lamps = area;
+    columns = lamp_columns(this);
+    gtk_widget_set_size_request(area,
+                                (columns - 1) * LAMP_PITCH + LAMP_CELL +
+                                ((columns - 1) / 4) *
+                                    (GROUP_PITCH - 4 * LAMP_PITCH),
+                                lamp_lines(this) * LINE_PITCH);
+    gtk_widget_set_halign(area, GTK_ALIGN_END);
+    gtk_widget_set_valign(area, GTK_ALIGN_CENTER);
+    if (this->options & RO_INSENSITIVE)
+        gtk_widget_set_sensitive(area, FALSE);
+    gtk_widget_add_events(area, GDK_BUTTON_PRESS_MASK);
+    g_signal_connect(area, "draw", G_CALLBACK(draw_lamps), this);
+    g_signal_connect(area, "button-press-event", G_CALLBACK(click_bit), this);
+    gtk_widget_show(area);
     set_reg(this);
-    return hbox;
+    return area;
 }
 
 /* Create a new visible register. */
@@ -698,6 +1927,9 @@ static char *thing_to_name(struct thing *it)
     case Overlay:
         n = it->u.overlay.name;
         break;
+    case List:
+        n = it->u.list.name;
+        break;
     default:
         n = NULL;
     }
@@ -796,6 +2028,192 @@ static GtkWidget *grid_new(struct grid *this, gboolean bare)
     return it;
 }
 
+/* A visible row of a list, showing one register at a time. */
+
+struct list_slot {
+    GtkWidget          *label;
+    GtkWidget          *entry;
+    struct reg         *reg;            /* Shown here, or NULL. */
+};
+
+/* Show a register in a list slot, or blank it if rp is NULL. */
+
+static void bind_slot(struct list_slot *slot, struct reg *rp)
+{
+    struct reg   *head;
+    unsigned int  type;
+
+    if (slot->reg == rp)
+        return;
+    if (slot->reg) {
+        slot->reg->u_entry = NULL;
+        g_atomic_int_add(&slot->reg->head->shown, -1);
+    }
+    slot->reg = rp;
+    if (!rp) {
+        gtk_label_set_text(GTK_LABEL(slot->label), "");
+        gtk_entry_set_text(GTK_ENTRY(slot->entry), "");
+        gtk_widget_set_sensitive(slot->entry, FALSE);
+        return;
+    }
+
+    /* Count the register as visible before reading its value,
+     * so that no later update from the simulator is missed.
+     */
+
+    head = rp->head;
+    g_atomic_int_inc(&head->shown);
+    type = display_style(rp);
+    if (rp != head) {
+        if (type == RO_STYLE_FP)
+            set_fp(rp, get_fp(head));
+        else
+            copy_words(reg_value(rp), rp->nwords,
+                       reg_value(head), head->nwords);
+    }
+    rp->u_entry = slot->entry;
+    rp->u_max_len = text_length(rp, type);
+    gtk_label_set_text(GTK_LABEL(slot->label), rp->name ? rp->name : "");
+    gtk_widget_set_sensitive(slot->entry, !(rp->options & RO_INSENSITIVE));
+    show_reg(rp, past_value(head));
+}
+
+/* A list has scrolled: move registers into and out of the slots. */
+
+static void list_moved(GtkAdjustment *adj, gpointer data)
+{
+    struct list *this;
+    int          i, first, rows;
+
+    this = (struct list *)data;
+    if (this->count > 0)
+        Ctx = this->items[0]->u.reg.ctx;
+    first = (int)(gtk_adjustment_get_value(adj) + 0.5);
+    rows = this->rows < this->count ? this->rows : this->count;
+    if (first > this->count - rows)
+        first = this->count - rows;
+    this->first = first;
+    for (i = 0; i < rows; ++i)
+        bind_slot(this->slots + i, &this->items[first + i]->u.reg);
+}
+
+/* Mouse wheel over a list. */
+
+static gboolean list_scroll(GtkWidget *widget, GdkEventScroll *event,
+                            gpointer data)
+{
+    struct list *this;
+    double       delta;
+
+    this = (struct list *)data;
+    switch (event->direction) {
+    case GDK_SCROLL_UP:
+        delta = -1.0;
+        break;
+    case GDK_SCROLL_DOWN:
+        delta = 1.0;
+        break;
+    case GDK_SCROLL_SMOOTH:
+        delta = event->delta_y;
+        break;
+    default:
+        return FALSE;
+    }
+    gtk_adjustment_set_value(this->adj,
+                             gtk_adjustment_get_value(this->adj) + 3 * delta);
+    return TRUE;
+}
+
+/* Callback for enter in a list slot. */
+
+static void slot_activate(GtkWidget *widget, gpointer data)
+{
+    struct list_slot *slot;
+
+    slot = (struct list_slot *)data;
+    if (slot->reg)
+        entry_activate(widget, slot->reg);
+}
+
+/* Create a scrolling list of registers.  Widgets are made only for
+ * the visible rows and reused as the list scrolls.
+ */
+
+static GtkWidget *list_new(struct list *this, gboolean bare)
+{
+    GtkWidget        *it, *box, *hbox, *grid, *bar;
+    struct list_slot *slot;
+    struct reg       *rp;
+    unsigned int      name_len, text_len, len;
+    int               i, rows;
+
+    /* Size the columns for the longest name and value. */
+
+    name_len = text_len = 1;
+    for (i = 0; i < this->count; ++i) {
+        rp = &this->items[i]->u.reg;
+        len = rp->name ? strlen(rp->name) : 0;
+        if (len > name_len)
+            name_len = len;
+        len = text_length(rp, display_style(rp));
+        if (len > text_len)
+            text_len = len;
+    }
+    if (text_len > 40)
+        text_len = 40;
+
+    grid = gtk_grid_new();
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 8);
+    rows = this->rows < this->count ? this->rows : this->count;
+    this->slots = g_new0(struct list_slot, rows);
+    g_object_set_data_full(G_OBJECT(grid), "slots", this->slots, g_free);
+    for (i = 0; i < rows; ++i) {
+        slot = this->slots + i;
+        slot->label = gtk_label_new("");
+        gtk_label_set_width_chars(GTK_LABEL(slot->label), (gint)name_len);
+        gtk_label_set_xalign(GTK_LABEL(slot->label), 0.0);
+        gtk_grid_attach(GTK_GRID(grid), slot->label, 0, i, 1, 1);
+        gtk_widget_show(slot->label);
+
+        slot->entry = gtk_entry_new();
+        gtk_entry_set_alignment((GtkEntry *)slot->entry, ALIGNMENT);
+        gtk_entry_set_width_chars((GtkEntry *)slot->entry,
+                                  (gint)text_len + 1);
+        g_signal_connect(slot->entry, "activate",
+                         G_CALLBACK(slot_activate), slot);
+        gtk_grid_attach(GTK_GRID(grid), slot->entry, 1, i, 1, 1);
+        gtk_widget_show(slot->entry);
+    }
+    gtk_widget_show(grid);
+
+    /* The scroll bar counts registers. */
+
+    this->adj = (GtkAdjustment *)gtk_adjustment_new(0.0, 0.0, this->count,
+                                                    1.0, rows, rows);
+    g_signal_connect(this->adj, "value-changed", G_CALLBACK(list_moved), this);
+    bar = gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL, this->adj);
+    hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    gtk_box_pack_start(GTK_BOX(hbox), grid, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), bar, FALSE, FALSE, 0);
+    if (this->count > rows)
+        gtk_widget_show(bar);
+    gtk_widget_show(hbox);
+
+    box = gtk_event_box_new();
+    gtk_widget_add_events(box, GDK_SCROLL_MASK | GDK_SMOOTH_SCROLL_MASK);
+    g_signal_connect(box, "scroll-event", G_CALLBACK(list_scroll), this);
+    gtk_container_add(GTK_CONTAINER(box), hbox);
+    if (bare) {
+        it = box;
+    } else {
+        it = gtk_frame_new(this->name);
+        gtk_container_add(GTK_CONTAINER(it), box);
+        gtk_widget_show(box);
+    }
+    list_moved(this->adj, this);
+    return it;
+}
+
 /* Create a new displayed item. */
 
 static GtkWidget *thing_to_widget(struct thing *thing, gboolean bare)
@@ -813,12 +2231,13 @@ static GtkWidget *thing_to_widget(struct thing *thing, gboolean bare)
     case Row:
         row = &thing->u.row;
         it = row_new(row, bare);
-        free(thing); // No longer needed.
         break;
     case Grid:
         grid = &thing->u.grid;
         it = grid_new(grid, bare);
-        free(thing); // No longer needed.
+        break;
+    case List:
+        it = list_new(&thing->u.list, bare);
         break;
     case Overlay:
         {
@@ -865,7 +2284,7 @@ gboolean New_thing_call(gpointer data)
 
     /* Add the display widget. */
 
-    gtk_box_pack_start(GTK_BOX(vbox1), thing_to_widget(thing, FALSE),
+    gtk_box_pack_start(GTK_BOX(Vbox), thing_to_widget(thing, FALSE),
                        FALSE, FALSE, 0);
     return FALSE;       /* Tell Glib loop we are finished. */
 }
@@ -876,7 +2295,8 @@ gboolean New_thing_call(gpointer data)
 
 static GtkSpinButton *add_spin(const char *name,
                                GtkCallback action, unsigned int *var,
-                               unsigned int max_width, GtkWidget *box)
+                               double max, unsigned int max_width,
+                               GtkWidget *box)
 {
     static GtkAdjustment *adj;
     GtkWidget            *ibox, *label, *spin;
@@ -888,7 +2308,7 @@ static GtkSpinButton *add_spin(const char *name,
     gtk_box_pack_start(GTK_BOX(ibox), label, FALSE, FALSE, 0);
     gtk_widget_show(label);
 
-    adj = (GtkAdjustment *)gtk_adjustment_new(*var, 1.0, 1.0e6,
+    adj = (GtkAdjustment *)gtk_adjustment_new(*var, 1.0, max,
                                               1.0, 100.0, 0.0);
     spin = gtk_spin_button_new(adj, 0.8, 0);
     if (action == NULL)
@@ -939,23 +2359,18 @@ static GtkWidget *add_button(const char  *name,
 
 static GtkWidget *clock_init(void)
 {
-    GtkWidget          *it, *hbox, *combo;
-
-    The_clock.run = 0;
-    The_clock.go = 0;
-    The_clock.cycles_fast = 0;
-    The_clock.cycles_slow = 1;
-    The_clock.cycles_sim = 1;
-    The_clock.rate = 20;    /* 2Hz. */
+    GtkWidget          *it, *hbox, *combo, *label, *entry;
+    GtkToggleButton    *but;
 
     it = gtk_frame_new("Clock");
     hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
     gtk_container_add(GTK_CONTAINER(it), hbox);
 
-    The_clock.run_button = add_toggle("_Run", NULL, &The_clock.run, hbox);
+    The_clock.run_button = add_toggle("_Run", click_run, &The_clock.run,
+                                      hbox);
     add_button("_Go", click_go, &The_clock, hbox);
     The_clock.burst = add_spin("Burst", cycles_new_value,
-                               &The_clock.cycles_slow, 12, hbox);
+                               &The_clock.cycles_slow, G_MAXUINT, 12, hbox);
 
     /* Add "units" combo box, initially hidden. */
 
@@ -968,23 +2383,70 @@ static GtkWidget *clock_init(void)
 
     The_clock.unit_reg.handle = COMBO_HANDLE;        // Dummy handle
     The_clock.unit_reg.u_entry = combo;
+    The_clock.unit_reg.nwords = 1;
+    The_clock.unit_reg.v.words = The_clock.unit_words;
     The_clock.unit_reg.options = RO_STYLE_COMBO;
     The_clock.unit_reg.clones = &The_clock.unit_reg; // Initialise list.
+    The_clock.unit_reg.ctx = Ctx;
 
     add_toggle("_Fast", click_fast, &The_clock, hbox);
-    add_spin("Speed", NULL, &The_clock.rate, 6, hbox);
+    but = add_toggle("_Auto", NULL, &The_clock.auto_burst, hbox);
+    gtk_widget_set_tooltip_text(GTK_WIDGET(but),
+                                "Size fast bursts for a responsive panel");
+    add_spin("Speed", NULL, &The_clock.rate, G_MAXUINT, 10, hbox);
+
+    /* Add target for a turbo run. */
+
+    label = gtk_label_new_with_mnemonic("Run _to");
+    gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, FALSE, 0);
+    gtk_widget_show(label);
+    entry = gtk_entry_new();
+    gtk_label_set_mnemonic_widget(GTK_LABEL(label), entry);
+    gtk_entry_set_alignment(GTK_ENTRY(entry), ALIGNMENT);
+    gtk_entry_set_width_chars(GTK_ENTRY(entry), 14);
+    gtk_widget_set_tooltip_text(entry,
+                                "Run at full speed to this cycle, "
+                                "updating the display only at the end");
+    g_signal_connect(entry, "activate", G_CALLBACK(run_to), NULL);
+    gtk_box_pack_start(GTK_BOX(hbox), entry, FALSE, FALSE, 0);
+    gtk_widget_show(entry);
+
+    /* Add history scrubber, shown when there is history. */
+
+    Scrub_adj = (GtkAdjustment *)gtk_adjustment_new(0.0, 0.0, 0.0,
+                                                    1.0, 0.0, 0.0);
+    g_signal_connect(Scrub_adj, "value-changed", G_CALLBACK(scrub_moved),
+                     Ctx);
+    Scrubber = gtk_scale_new(GTK_ORIENTATION_HORIZONTAL, Scrub_adj);
+    gtk_scale_set_digits(GTK_SCALE(Scrubber), 0);
+    gtk_widget_set_size_request(Scrubber, 200, -1);
+    gtk_widget_set_tooltip_text(Scrubber,
+                                "Show past values: move right for the present");
+    gtk_box_pack_start(GTK_BOX(hbox), Scrubber, TRUE, TRUE, 0);
+
+    /* Add capture state and re-arm button, shown after Blink_arm(). */
+
+    Capture_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    Capture_label = gtk_label_new("");
+    gtk_box_pack_start(GTK_BOX(Capture_box), Capture_label, FALSE, FALSE, 0);
+    gtk_widget_show(Capture_label);
+    add_button("Re-_arm", click_arm, NULL, Capture_box);
+    gtk_box_pack_start(GTK_BOX(hbox), Capture_box, FALSE, FALSE, 0);
+
+    /* Add the watch status, empty until a watch is set or met. */
+
+    Watch_label = gtk_label_new("");
+    gtk_box_pack_start(GTK_BOX(hbox), Watch_label, FALSE, FALSE, 0);
+    gtk_widget_show(Watch_label);
 
     gtk_widget_show(hbox);
     gtk_widget_show(it);
     return it;
 }
 
-/* Remove padding around the lamp in per-bit buttons and provide
- * a narrow margin below to centre vertically.
- */
+/* Shade the frames around registers. */
 
 #define CSS \
-    "button { padding: 0px; margin: 0px 0px 6px 0px; }\n" \
     "frame { padding: 4px; background-color: #ddd; }\n"
 
 static void setup_style(void)
@@ -1011,11 +2473,12 @@ static void build_ui(const char * title)
     GtkWidget *window;
     GtkWidget *it;
      
-    Init_lights();
-    setup_style();
     window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    g_object_set_data(G_OBJECT(window), CTX_KEY, Ctx);
     g_signal_connect(window, "delete-event", G_CALLBACK(delete_event), NULL);
-    g_signal_connect(window, "destroy", G_CALLBACK(destroy_cb), NULL);
+    g_signal_connect(window, "destroy", G_CALLBACK(destroy_cb), Ctx);
+    Top_window = window;
+    start_ticks(NULL);
 
     /* Request key down events. */
 
@@ -1023,8 +2486,8 @@ static void build_ui(const char * title)
     g_signal_connect(window, "key_press_event",
                      G_CALLBACK(key_cb), &The_clock);
 
-    vbox1 = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
-    gtk_container_add(GTK_CONTAINER(window), vbox1);
+    Vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
+    gtk_container_add(GTK_CONTAINER(window), Vbox);
 
     if (title && title[0])
         gtk_window_set_title(GTK_WINDOW(window), title);
@@ -1046,16 +2509,50 @@ static void build_ui(const char * title)
         add_button("_Quit", do_quit, NULL, tbox);
 #endif
         gtk_widget_show(tbox);
-        gtk_box_pack_start(GTK_BOX(vbox1), tbox, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(Vbox), tbox, FALSE, FALSE, 0);
     }
 #endif
 
     it = clock_init();
-    gtk_box_pack_start(GTK_BOX(vbox1), it, FALSE, FALSE, 0);
-    gtk_widget_show(vbox1);
+    gtk_box_pack_start(GTK_BOX(Vbox), it, FALSE, FALSE, 0);
+    gtk_widget_show(Vbox);
     gtk_widget_show(window);
 }
 
+/* Arguments of Start_Panel(), copied for the UI thread. */
+
+struct panel_args {
+    char               *title;
+    char              **unit_strings;
+    unsigned int        initial_unit;
+};
+
+/* Build a window, called directly for the first and by the UI thread
+ * for the others.
+ */
+
+static gboolean build_panel(gpointer data)
+{
+    struct panel_args  *ap;
+    char              **sp;
+    int                 count;
+
+    ap = (struct panel_args *)data;
+    build_ui(ap->title);
+    if (ap->unit_strings) {
+        for (count = 0, sp = ap->unit_strings; *sp; ++sp, ++count)
+            gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(The_clock.combo),
+                                           *sp);
+        The_clock.unit_reg.u_max_len = count;
+        gtk_combo_box_set_active(The_clock.combo, ap->initial_unit);
+        gtk_widget_show((GtkWidget *)The_clock.combo);
+    }
+    g_free(ap->title);
+    g_strfreev(ap->unit_strings);
+    g_free(ap);
+    return FALSE;       /* Tell Glib loop we are finished. */
+}
+
 /* Main function for the Gtk UI thread. */
 
 static gpointer panel_thread(gpointer UNUSED(user_data))
@@ -1064,26 +2561,112 @@ static gpointer panel_thread(gpointer UNUSED(user_data))
     return NULL;
 }
 
-/* Start the UI thread. */
+/* Show the calling thread's context in a new window.  The first call
+ * starts Gtk and the UI thread, and later ones queue the window for it,
+ * ahead of the items the simulation adds.
+ */
+
+static GMutex   Start_lock;
+static gboolean Started;
 
 void Start_Panel(const char * title,
                  const char **unit_strings, unsigned int initial_unit)
 {
-    static int   argc;
+    static int          argc;
+    struct panel_args  *ap;
+    const char         *fps, *target;
 
-    /* build_ui() must be called before starting simulation. */
+    Ctx->panel = g_new0(struct panel_state, 1);
+    The_clock.run = 0;
+    The_clock.go = 0;
+    The_clock.cycles_fast = 0;
+    The_clock.cycles_slow = 1;
+    The_clock.cycles_sim = 1;
+    The_clock.rate = 20;    /* 2Hz. */
+    target = getenv("BLINK_BURST_TARGET");
+    if (target && atoi(target) > 0)
+        The_clock.burst_target = atoi(target);
+    else
+        The_clock.burst_target = AUTO_BURST_TARGET;
 
-    gtk_init(&argc, NULL);
-    build_ui(title);
-    if (unit_strings) {
-        int count;
+    ap = g_new(struct panel_args, 1);
+    ap->title = g_strdup(title);
+    ap->unit_strings = g_strdupv((char **)unit_strings);
+    ap->initial_unit = initial_unit;
 
-        for (count = 0; *unit_strings; ++unit_strings, ++count)
-            gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(The_clock.combo),
-                                           *unit_strings);
-        The_clock.unit_reg.u_max_len = count;
-        gtk_combo_box_set_active(The_clock.combo, initial_unit);
-        gtk_widget_show((GtkWidget *)The_clock.combo);
+    g_mutex_lock(&Start_lock);
+    if (Started) {
+        Call_UI(build_panel, ap, G_PRIORITY_DEFAULT);
+    } else {
+        fps = getenv("BLINK_FPS");
+        if (fps && atoi(fps) > 0)
+            Frame_interval = G_TIME_SPAN_SECOND / atoi(fps);
+
+        /* The first window must be built before starting simulation. */
+
+        gtk_init(&argc, NULL);
+        Init_lights();
+        setup_style();
+        build_panel(ap);
+        g_thread_new("Panel UI thread", panel_thread, NULL);
+        Started = TRUE;
+    }
+    g_mutex_unlock(&Start_lock);
+}
+
+/* Release a context's window and its data, in the UI thread.  The
+ * context's simulation has ended, so anything it queued is done first.
+ */
+
+struct panel_free {
+    struct blink_ctx   *ctx;
+    GMutex              lock;
+    GCond               done;
+    gboolean            freed;
+};
+
+static gboolean free_panel(gpointer data)
+{
+    struct panel_free  *fp;
+    struct panel_state *pp;
+
+    fp = (struct panel_free *)data;
+    Ctx = fp->ctx;
+    pp = Ctx->panel;
+    if (!pp->closed)
+        gtk_widget_destroy(pp->window);
+    g_free(pp->glowing);
+    g_free(pp->waves);
+    g_free(pp->views);
+    g_free(pp);
+    Ctx->panel = NULL;
+    g_mutex_lock(&fp->lock);
+    fp->freed = TRUE;
+    g_cond_signal(&fp->done);
+    g_mutex_unlock(&fp->lock);
+    return FALSE;
+}
+
+void Panel_free(void)
+{
+    struct panel_free fp;
+
+    if (!Ctx->panel)
+        return;
+    if (g_atomic_int_get(&UI_gone)) {
+        g_free(Ctx->panel);             /* The process is ending. */
+        Ctx->panel = NULL;
+        return;
     }
-    g_thread_new("Panel UI thread", panel_thread, NULL);
+    fp.ctx = Ctx;
+    fp.freed = FALSE;
+    g_mutex_init(&fp.lock);
+    g_cond_init(&fp.done);
+    g_idle_add_full(G_PRIORITY_LOW, free_panel, &fp, NULL);
+    g_mutex_lock(&fp.lock);
+    while (!fp.freed)
+        g_cond_wait(&fp.done, &fp.lock);
+    g_mutex_unlock(&fp.lock);
+    g_mutex_clear(&fp.lock);
+    g_cond_clear(&fp.done);
 }
@@ -4,59 +4,171 @@
 #  define UNUSED(x) UNUSED_ ## x
 #endif
 
-/* Stuff for a row of lights. */
-
-typedef GtkWidget *Button;
-
 /* This structure describes a displayed register. If modifying, check
  * the definition of REGISTER_BASE_SIZE below.
+ *
+ * Integer registers may have any width, so the value and flags are arrays
+ * of 64-bit words, least significant first.  They follow the structure
+ * in the same allocation, with the activity: the bits that the simulator
+ * changed since the UI last took them.  For the bits style these are
+ * followed by copies of the value, flags and activity last shown.
+ *
+ * The value, flags, state and dirty fields are shared between the
+ * simulation and UI threads without locking, so use atomic access.
+ */
+
+/* Optional history of the values of a register, in its head only.
+ * See record() and History_at() in sim.c.
  */
 
+struct history {
+    unsigned int        depth;          /* Entries, a power of 2. */
+    unsigned int        stride;         /* Words per entry: time, value. */
+    guint64             count;          /* Entries ever written. */
+    guint64             words[];
+};
+
+/* Samples of a floating-point register plotted as a scope trace, in its
+ * head only.  Level 0 holds the samples, the others the minimum and
+ * maximum of blocks of samples.  See scope.c.
+ */
+
+#define SCOPE_LEVELS 8
+
+struct scope {
+    guint64             count;          /* Samples ever added. */
+    unsigned int        depth;          /* Samples held, a power of 2. */
+    unsigned int        levels;         /* Levels in use. */
+    double             *level[SCOPE_LEVELS];
+};
+
+struct scope_view;                      /* Private to panel.c. */
+
 typedef enum update_state {
-    Valid = 0, User, Simulation
+    Valid = 0, User
 } Update_state;
 
 struct reg {
     char               *name;
     unsigned int        width;          /* Number of bits. */
+    unsigned int        nwords;         /* Words in value, and in flags. */
     union {
-        struct {
-            unsigned int        value;  /* Register contents. */
-            unsigned int        flags;  /* Per-bit settings. */
-        }                   u;
+        guint64            *words;      /* Contents, then per-bit settings. */
         double              fp_value;   /* It shows floating-point. */
     }                   v;
     unsigned int        options;        /* Bitfield, see sim.h. */
     Update_state        state;          /* Update pending? */
+    unsigned int        dirty;          /* Display refresh needed. */
     struct reg         *clones;         /* Others with same handle. */
+    struct reg         *head;           /* First with same handle. */
+    unsigned int        shown;          /* Visible clones, in head only. */
+    struct history     *history;        /* Past values, in head only. */
+    struct scope       *scope;          /* Plotted samples, in head only. */
+    unsigned int        watched;        /* Watches on it, in head only. */
+    unsigned int        seq;            /* Updates from other threads. */
+    unsigned int        seq_value;      /* Last stored of those, and */
+    unsigned int        seq_flags;      /* the simulation thread's. */
     struct reg         *chain;          /* Pending update list. */
+    struct reg         *dirty_chain;    /* Pending refresh list. */
     Sim_RH              handle;         /* Simulator's handle. */
+    Blink_RID           id;             /* Index in register table. */
+    struct blink_ctx   *ctx;            /* Context it belongs to. */
     union {
         struct {                        /* Display individual bits. */
-            unsigned int        prev_value, prev_flags;
-            Button              buttons[];
+            guint64            *prev;   /* Value, flags, activity shown. */
+            GtkWidget          *lamps;  /* Drawing area. */
         }                   b;
         struct {                        /* Text entry or combo-box widget. */
             unsigned int         max_len;
             GtkWidget           *entry;
             const char          * const *strings; // For combo-box.
         }                   e;
+        struct {                        /* Waveform. */
+            unsigned int         max_len; /* Label digits, as u.e.max_len. */
+            GtkWidget           *area;
+            int                  shift; /* Log2 cycles per pixel, or -1. */
+        }                   w;
+        struct {                        /* Scope plot. */
+            unsigned int         max_len; /* Unused, as u.e.max_len. */
+            struct scope_view   *view;
+        }                   s;
     }                   u;
 };
 
-#define u_value v.u.value
-#define u_flags v.u.flags
 #define fp_value v.fp_value
 
+/* Internal option bits, above those in sim.h. */
+
+#define RO_LISTED 0x8000                /* In a list: u.e.entry may be NULL. */
+
+#define WORD_BITS 64
+#define REG_WORDS(width) ((width) > WORD_BITS ? \
+                          ((width) + WORD_BITS - 1) / WORD_BITS : 1)
+#define reg_value(rp) ((rp)->v.words)
+#define reg_flags(rp) ((rp)->v.words + (rp)->nwords)
+#define reg_activity(rp) ((rp)->v.words + 2 * (rp)->nwords)
+
 #define u_entry u.e.entry
 #define u_max_len u.e.max_len
 
-/* List of struct_regs with pending simulator updates - mutex locked. */
+/* Atomic access to a value word. */
+
+static inline guint64 get_word(const guint64 *wp)
+{
+    return __atomic_load_n(wp, __ATOMIC_SEQ_CST);
+}
+
+static inline void set_word(guint64 *wp, guint64 v)
+{
+    __atomic_store_n(wp, v, __ATOMIC_SEQ_CST);
+}
+
+/* Atomic access to a floating-point value. */
+
+static inline double get_fp(struct reg *rp)
+{
+    double v;
+
+    __atomic_load(&rp->fp_value, &v, __ATOMIC_SEQ_CST);
+    return v;
+}
+
+static inline void set_fp(struct reg *rp, double v)
+{
+    __atomic_store(&rp->fp_value, &v, __ATOMIC_SEQ_CST);
+}
 
-extern struct reg *User_modified_regs;
+/* List of struct_regs with pending simulator updates - lock-free.
+ * The UI thread pushes edits with compare-and-exchange, and sets
+ * EXIT_VALUE when the window closes.  The simulation thread takes
+ * the whole list the same way, so all stores made before an edit was
+ * queued are visible to it.  It first tests with EDITS_PENDING(), a single
+ * relaxed load, which is enough to decide whether to look.
+ */
+
+#define User_modified_regs (Ctx->user_modified_regs)
 
 #define EXIT_VALUE ((struct reg *)1) // Magic value.
 
+#define EDITS_PENDING() \
+    (__atomic_load_n(&User_modified_regs, __ATOMIC_RELAXED) != NULL)
+
+/* Count a change for Blink_changes(), after making it, and signal
+ * the descriptor from Blink_get_fd(), if any.
+ */
+
+extern void Count_change(void);
+
+/* List of struct_regs changed by the simulator and waiting to be shown
+ * at the next display frame - lock-free.  A register is on the list
+ * when its "dirty" field is not zero.
+ */
+
+#define Dirty_regs (Ctx->dirty_regs)
+
+#define DIRTY_VALUE 1
+#define DIRTY_FLAGS 2
+
 /* Stuff for clock control. */
 
 struct clock {
@@ -64,29 +176,44 @@ struct clock {
     unsigned int        run;            /* Run/stop. */
     unsigned int        go;             /* Start burst. */
     unsigned int        fast;           /* Start burst. */
-    unsigned int        cycles_slow;    /* Cycles/burst - slow. */
+    unsigned int        cycles_slow;    /* Cycles per Go step. */
     unsigned int        cycles_fast;    /* Cycles/burst - fast. */
     unsigned int        cycles_sim;     /* Cycles/burst - simulator's own. */
     unsigned int        rate;           /* Clock rate: unit is 0.1 Hz. */
     unsigned int        unit;           /* Passed to simulator. */
+    guint64             cycle_count;    /* Fast cycles handed out. */
+    guint64             cycle_limit;    /* Stop after this many, if set. */
+    unsigned int        auto_burst;     /* Size fast bursts by time. */
+    unsigned int        burst_target;   /* Time for each, microseconds. */
+    unsigned int        turbo;          /* Running to target, not shown. */
+    guint64             target;         /* Cycle to stop turbo run. */
     GtkToggleButton    *run_button;
     GtkComboBox        *combo;
     GtkSpinButton      *burst;
     struct reg          unit_reg;       /* Dummy registers for combo-box. */
+    guint64             unit_words[2];  /* Its value and flags. */
 };
 
 #define COMBO_HANDLE ((Sim_RH)&The_clock.unit_reg) // Dummy handle
 
-/* Boundary between animated and full-speed running. */
+/* Default time for an automatically-sized fast burst, microseconds. */
+
+#define AUTO_BURST_TARGET 10000
+
+/* Above this rate, animation gives several cycles per burst. */
 
 #define MAX_ANIMATED_RATE 100           /* 10Hz clock. */
 
-/* Structure passed from simulator to describe a row of registers. */
+/* Structure passed from simulator to describe a row of registers.
+ * Container lists grow by doubling, so items must be the last member:
+ * see ROW_BASE_SIZE below.
+ */
 
 struct row {
     char               *name;
     int                 count;          /* How many regs? */
-    struct thing       *items[MAX_ITEMS];
+    int                 size;           /* Space allocated in items. */
+    struct thing      **items;
 };
 
 /* Structure passed from simulator to describe a grid of registers. */
@@ -95,7 +222,8 @@ struct grid {
     char               *name;
     int                 columns;
     int                 count;          /* How many regs? */
-    struct thing       *items[MAX_ITEMS];
+    int                 size;           /* Space allocated in items. */
+    struct thing      **items;
 };
 
 /* Structure passed from simulator to describe an overlayed display. */
@@ -106,19 +234,39 @@ struct overlay {
     char               *name;
     unsigned int        choice;         /* Which one to show? */
     int                 count;          /* How many regs? */
+    int                 size;           /* Space allocated in items. */
     GtkStack           *stack;          /* The display area. */
-    GtkWidget          *items[MAX_ITEMS];
+    GtkWidget         **items;
+};
+
+/* Structure passed from simulator to describe a scrolling list of
+ * registers.  Only the visible rows have widgets, in the slots array,
+ * and these are reused as the list scrolls.
+ */
+
+struct list_slot;                       /* Private to panel.c. */
+
+struct list {
+    char               *name;
+    int                 rows;           /* How many visible? */
+    int                 count;          /* How many regs? */
+    int                 size;           /* Space allocated in items. */
+    int                 first;          /* Index of top visible row. */
+    GtkAdjustment      *adj;            /* Of the scroll bar. */
+    struct list_slot   *slots;
+    struct thing      **items;
 };
 
 /* The simulator-side handles resolve to pointers to this stucture. */
 
 struct thing {
-    enum {Register, Row, Grid, Overlay} type;
+    enum {Register, Row, Grid, Overlay, List} type;
     union {
         struct reg     reg;
         struct row     row;
         struct grid    grid;
-        struct overlay overlay;}  u;
+        struct overlay overlay;
+        struct list    list;}     u;
 };
 
 /* Sizes of various "things" without any trailing variable-length arrays. */
@@ -126,16 +274,60 @@ struct thing {
 #define BASE_SIZE(u_member, s_member) \
     ((uintptr_t)&((struct thing *)0)->u.u_member.s_member)
 #define REGISTER_BASE_SIZE (BASE_SIZE(reg, u.e.strings) + sizeof (char *))
-#define ROW_BASE_SIZE BASE_SIZE(row, items[MAX_ITEMS + 1])
-#define GRID_BASE_SIZE BASE_SIZE(grid, items[MAX_ITEMS + 1])
-#define OVERLAY_BASE_SIZE BASE_SIZE(overlay, items[MAX_ITEMS + 1])
+#define ROW_BASE_SIZE (BASE_SIZE(row, items) + sizeof (struct thing **))
+#define GRID_BASE_SIZE (BASE_SIZE(grid, items) + sizeof (struct thing **))
+#define OVERLAY_BASE_SIZE (BASE_SIZE(overlay, items) + sizeof (GtkWidget **))
+#define LIST_BASE_SIZE (BASE_SIZE(list, items) + sizeof (struct thing **))
+
+/* Per-simulation data.  A process may run several simulations, each in
+ * its own thread with its own context, selected by Blink_use_context().
+ * Ctx is the calling thread's context.  The UI thread shows each context
+ * in its own window, and selects the context of a window before handling
+ * anything for it.  The shared data below are members of the context,
+ * named by macros.  The "sim", "trace" and "panel" members hold the
+ * private data of sim.c, trace.c and the UI back-end.
+ */
+
+struct sim_state;
+struct trace_state;
+struct panel_state;
+
+struct blink_ctx {
+    struct clock        clock;
+    struct reg         *user_modified_regs;
+    struct reg         *dirty_regs;
+    GMutex              simulation_mutex;
+    GCond               simulation_waker;
+    guint64             sim_time;
+    gint                history_begun;
+    guint64             history_start;
+    guint64             watch_time;
+    gboolean            tracing;
+    gboolean            capturing;
+    gint                capture_state;
+    gint                capture_rearm;
+    struct sim_state   *sim;
+    struct trace_state *trace;
+    struct panel_state *panel;
+};
+
+/* Thread-local data.  The default model is kept, as the library may be
+ * loaded by dlopen(), so registers carry their context for the paths
+ * taken on every value.
+ */
+
+#define THREAD_LOCAL __thread
+
+extern THREAD_LOCAL struct blink_ctx *Ctx;
+extern struct blink_ctx Main_ctx;
 
 /* Global data and functions. */
 
-extern struct clock           The_clock;
+#define The_clock (Ctx->clock)
 
 extern GdkPixbuf *Lamps[4];     /* Images for button state indicators. */
 
+#define LAMP_SIZE 8             /* Lamp images are square. */
 #define BLACK 0
 #define RED   1
 #define BLUE  2
@@ -143,34 +335,133 @@ extern GdkPixbuf *Lamps[4];     /* Images for button state indicators. */
 
 extern void Init_lights(void);
 
-/* Locking for the above. */
+/* Locking for the waker below. */
 
-extern GMutex           Simulation_mutex;
+#define Simulation_mutex (Ctx->simulation_mutex)
 
 /* To wake sleeping simulation thread. */
 
-extern GCond            Simulation_waker;
+#define Simulation_waker (Ctx->simulation_waker)
+
+/* Simulated time and the time of the first history entry, if any. */
+
+#define Sim_time (Ctx->sim_time)
+#define History_begun (Ctx->history_begun)
+#define History_start (Ctx->history_start)
 
 /* Functions. */
 
 extern void Start_Panel(const char * title,
                         const char **unit_strings, unsigned int initial_unit);
 
+/* Release the calling thread's context's display, from
+ * Blink_free_context().
+ */
+
+extern void Panel_free(void);
+
+/* Make a cross-thread call to one of the functions below.  The UI back-end
+ * provides this: the Gtk panel queues it to the Glib loop as an idle-time
+ * function with the given priority, to be called with the caller's context
+ * selected, and the headless one calls it directly.
+ */
+
+extern void Call_UI(GSourceFunc fn, gpointer data, gint priority);
+
+/* Called by the simulation thread when the context's Dirty_regs was empty,
+ * so that an idle display starts refreshing again.  Also provided by the
+ * back-end.
+ */
+
+extern void Wake_display(struct blink_ctx *ctx);
+
+/* Functions in sim.c that may be called by the UI.  History_at() gets
+ * the value words of a register at a past time, returning FALSE if
+ * there is no history.  Register_table() returns the heads of all
+ * register clone lists, indexed by ID.
+ */
+
+extern gboolean History_at(struct reg *head, guint64 time, guint64 *words);
+extern struct reg **Register_table(unsigned int *countp);
+
+/* Conditions for captures and watches.  Condition_met() tests one against
+ * the low words of a register's previous and current values.
+ * Toggle_watch() removes a watch with the same condition, or adds one,
+ * returning the number of watches set.  Watch_time is the cycle when
+ * the last watch met was found.
+ */
+
+extern gboolean Condition_met(const struct blink_condition *cp,
+                              guint64 old, guint64 now);
+extern int Toggle_watch(const struct blink_condition *cond);
+#define Watch_time (Ctx->watch_time)
+
+/* History_runs() samples history for a waveform, one column per pixel.
+ * Adjacent columns without a change, or where the value changed more than
+ * once in every column, are joined in a run.
+ */
+
+struct wave_run {
+    unsigned int        start;          /* First column. */
+    unsigned int        length;         /* Number of columns. */
+    unsigned int        kind;           /* See below. */
+};
+
+#define WAVE_NONE       0               /* Before the history. */
+#define WAVE_STEADY     1               /* One value, set at the start. */
+#define WAVE_BUSY       2               /* Several changes per column. */
+
+extern unsigned int History_runs(struct reg *head, guint64 time, guint64 step,
+                                 unsigned int columns, struct wave_run *runs,
+                                 guint64 *words);
+
+/* Recording in trace.c, called by the simulation thread. */
+
+#define Tracing (Ctx->tracing)
+extern void Trace_change(struct reg *rp);
+extern void Trace_start_env(void);
+extern void Trace_free(void);
+
+/* Triggered capture, also in trace.c.  Capture_state is a
+ * BLINK_CAPTURE_ value, and the UI sets Capture_rearm to arm again.
+ */
+
+#define Capturing (Ctx->capturing)
+#define Capture_state (Ctx->capture_state)
+#define Capture_rearm (Ctx->capture_rearm)
+extern void Capture_change(struct reg *rp);
+extern void Capture_poll(void);
+extern void Capture_stop(void);
+
+/* Sample storage in scope.c.  Scope_add() is called by the simulation
+ * thread, the others by the UI.
+ */
+
+#define SCOPE_NONE G_MAXUINT64
+
+extern struct scope *Scope_new(void);
+extern void Scope_free(struct scope *sp);
+extern void Scope_add(struct scope *sp, double value);
+extern guint64 Scope_count(struct scope *sp);
+extern gboolean Scope_columns(struct scope *sp, guint64 end,
+                              unsigned int shift, unsigned int columns,
+                              double *mins, double *maxs);
+extern guint64 Scope_trigger(struct scope *sp, double level, guint64 last);
+
 /* Functions called via the Glib loop idle mechanism - cross thread calls. */
 
 /* Create new visible items. */
 
 gboolean New_thing_call(gpointer data);   /* Argument is struct thing *. */
 
-/* Set a register value or display flags, from the simulation thread. */
-
-gboolean Simulation_call(gpointer data);  /* Arg is struct reg *. */
-gboolean Flag_call(gpointer data);        /* Arg is struct reg *. */
-
 /* Update the "burst" field. */
 
 gboolean Display_burst(gpointer data);
 
+/* The run stopped: argument is one more than the watch number met, or 0. */
+
+gboolean Show_stopped(gpointer data);
+
 /* Change the visible component in an overlay. */
 
 gboolean Overlay_switch(gpointer data); /* Arg is struct overlayed_regs *. */
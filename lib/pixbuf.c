@@ -4,7 +4,7 @@
 #include "sim.h"
 #include "panel.h"
 
-#define SIZE 8
+#define SIZE LAMP_SIZE
 
 #define s ((((((((((((((((0
 
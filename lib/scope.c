@@ -0,0 +1,291 @@
+/*
+ * Copyright 2024 Giles Atkinson
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* Sample storage for floating-point registers plotted as a scope trace.
+ *
+ * Every value given by the simulator is a sample, kept in a ring of
+ * SCOPE_DEPTH.  Above the ring is a pyramid of coarser levels: level k
+ * holds the minimum and maximum of each block of SCOPE_FAN^k samples,
+ * and is also a ring, of SCOPE_DEPTH / SCOPE_FAN^k entries.  Levels are
+ * added until the top one has fewer than SCOPE_FAN entries, so a plot
+ * column covering any power of two samples, up to SCOPE_DEPTH, is found
+ * from at most SCOPE_FAN entries of one level.  Drawing costs then depend
+ * on the plot's width, not on the number of samples shown.
+ *
+ * The ring and pyramid take about 9MB, so they are allocated only when
+ * the first sample arrives.
+ *
+ * Only the simulation thread writes, without locking.  As with the value
+ * history in sim.c, a reader loads the sample count first and checks
+ * afterwards that the entries it used were not overwritten meanwhile.
+ * A ring entry at any level is reused only after SCOPE_DEPTH more samples,
+ * so one test covers all levels.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "sim.h"
+#include "no_gtk.h"
+#include "panel.h"
+
+#define SCOPE_DEPTH     (1 << 20)       /* Samples held. */
+#define SCOPE_FAN_SHIFT 3
+#define SCOPE_FAN       (1 << SCOPE_FAN_SHIFT)
+
+/* Atomic access to stored samples. */
+
+static inline double get_sample(const double *dp)
+{
+    double v;
+
+    __atomic_load(dp, &v, __ATOMIC_RELAXED);
+    return v;
+}
+
+static inline void set_sample(double *dp, double v)
+{
+    __atomic_store(dp, &v, __ATOMIC_RELAXED);
+}
+
+/* Address of an entry at a level: a sample, or a minimum and maximum. */
+
+static double *entry(struct scope *sp, unsigned int k, guint64 n)
+{
+    if (k == 0)
+        return sp->level[0] + (n & (sp->depth - 1));
+    return sp->level[k] +
+               2 * (n & ((sp->depth >> (SCOPE_FAN_SHIFT * k)) - 1));
+}
+
+struct scope *Scope_new(void)
+{
+    struct scope *sp;
+    unsigned int  k;
+
+    sp = g_new0(struct scope, 1);
+    sp->depth = SCOPE_DEPTH;
+    for (k = 1; k < SCOPE_LEVELS; ++k) {
+        if ((sp->depth >> (SCOPE_FAN_SHIFT * (k - 1))) < SCOPE_FAN)
+            break;                      /* Level k - 1 is the top. */
+    }
+    sp->levels = k;
+    return sp;
+}
+
+/* Allocate the levels, before the first sample is stored. */
+
+static void allocate_levels(struct scope *sp)
+{
+    unsigned int  k;
+    size_t        size;
+
+    size = sp->depth;
+    for (k = 1; k < sp->levels; ++k)
+        size += 2 * (sp->depth >> (SCOPE_FAN_SHIFT * k));
+    sp->level[0] = g_new(double, size);
+    for (k = 1; k < sp->levels; ++k) {
+        sp->level[k] = (k == 1 ? sp->level[0] + sp->depth :
+                                 sp->level[k - 1] +
+                                     2 * (sp->depth >>
+                                          (SCOPE_FAN_SHIFT * (k - 1))));
+    }
+}
+
+void Scope_free(struct scope *sp)
+{
+    g_free(sp->level[0]);
+    g_free(sp);
+}
+
+/* Add a sample, called by the simulation thread. */
+
+void Scope_add(struct scope *sp, double value)
+{
+    guint64       n;
+    double       *ep;
+    unsigned int  k;
+
+    n = sp->count;
+    if (G_UNLIKELY(!sp->level[0]))
+        allocate_levels(sp);            /* Published by the count. */
+
+    /* Order the previous count update before the new entries. */
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    set_sample(entry(sp, 0, n), value);
+    for (k = 1; k < sp->levels; ++k) {
+        ep = entry(sp, k, n >> (SCOPE_FAN_SHIFT * k));
+        if ((n & (((guint64)1 << (SCOPE_FAN_SHIFT * k)) - 1)) == 0) {
+            set_sample(ep, value);              /* First in block. */
+            set_sample(ep + 1, value);
+        } else {
+            if (value < get_sample(ep))
+                set_sample(ep, value);
+            if (value > get_sample(ep + 1))
+                set_sample(ep + 1, value);
+        }
+    }
+    __atomic_store_n(&sp->count, n + 1, __ATOMIC_RELEASE);
+}
+
+/* Samples that may be read: from *lop to the returned count. */
+
+static guint64 readable(struct scope *sp, guint64 *lop, unsigned int slack)
+{
+    guint64 count;
+
+    count = __atomic_load_n(&sp->count, __ATOMIC_ACQUIRE);
+    *lop = (count > sp->depth - slack) ? count - (sp->depth - slack) : 0;
+    return count;
+}
+
+/* Check that nothing read was overwritten. */
+
+static gboolean still_valid(struct scope *sp, guint64 count,
+                            unsigned int slack)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sp->count, __ATOMIC_RELAXED) < count + slack;
+}
+
+guint64 Scope_count(struct scope *sp)
+{
+    return __atomic_load_n(&sp->count, __ATOMIC_ACQUIRE);
+}
+
+/* Find the minimum and maximum in each of "columns" blocks of 2^shift
+ * samples, the last ending before sample "end", rounded down to a
+ * whole block.  Columns without samples are set to NaN.
+ * Returns FALSE if the samples could not be read.
+ */
+
+gboolean Scope_columns(struct scope *sp, guint64 end, unsigned int shift,
+                       unsigned int columns, double *mins, double *maxs)
+{
+    guint64       count, lo, start, b;
+    double        low, high, v, *ep;
+    unsigned int  c, j, k, per, tries, slack;
+
+    slack = sp->depth / 8;
+    k = shift / SCOPE_FAN_SHIFT;
+    if (k >= sp->levels)
+        k = sp->levels - 1;
+    per = 1u << (shift - SCOPE_FAN_SHIFT * k);
+    for (tries = 0; tries < 10; ++tries) {
+        count = readable(sp, &lo, slack);
+        if (end > count)
+            end = count;
+        end &= ~(((guint64)1 << shift) - 1);
+        for (c = 0; c < columns; ++c) {
+            mins[c] = maxs[c] = NAN;
+            if (columns - c > (end >> shift))
+                continue;
+            start = end - ((guint64)(columns - c) << shift);
+            if (start < lo)
+                continue;
+            b = start >> (SCOPE_FAN_SHIFT * k);
+            low = INFINITY;
+            high = -INFINITY;
+            for (j = 0; j < per; ++j) {
+                ep = entry(sp, k, b + j);
+                v = get_sample(ep);
+                if (v < low)
+                    low = v;
+                if (k > 0)
+                    v = get_sample(ep + 1);
+                if (v > high)
+                    high = v;
+            }
+            mins[c] = low;
+            maxs[c] = high;
+        }
+        if (still_valid(sp, count, slack))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Search blocks first to last of level k, latest first, for a rising
+ * crossing at sample n, with lo < n <= hi.  Blocks whose range does not
+ * include the level are skipped.
+ */
+
+static guint64 find_rise(struct scope *sp, unsigned int k,
+                         guint64 first, guint64 last, double level,
+                         guint64 lo, guint64 hi)
+{
+    guint64  b, n, result;
+    double  *ep;
+
+    for (b = last + 1; b-- > first; ) {
+        if (k > 0) {
+            ep = entry(sp, k, b);
+            if (get_sample(ep) < level && get_sample(ep + 1) >= level) {
+                result = find_rise(sp, k - 1,
+                                   MAX(b << SCOPE_FAN_SHIFT,
+                                       lo >> (SCOPE_FAN_SHIFT * (k - 1))),
+                                   MIN((b << SCOPE_FAN_SHIFT) +
+                                           SCOPE_FAN - 1,
+                                       hi >> (SCOPE_FAN_SHIFT * (k - 1))),
+                                   level, lo, hi);
+                if (result != SCOPE_NONE)
+                    return result;
+            }
+        }
+
+        /* Crossing from the previous block. */
+
+        n = b << (SCOPE_FAN_SHIFT * k);
+        if (n > lo && n <= hi &&
+            get_sample(entry(sp, 0, n - 1)) < level &&
+            get_sample(entry(sp, 0, n)) >= level) {
+            return n;
+        }
+    }
+    return SCOPE_NONE;
+}
+
+/* Find the last sample, not after "last", that is at least "level" when
+ * the one before is below it.  Returns SCOPE_NONE if there is none.
+ */
+
+guint64 Scope_trigger(struct scope *sp, double level, guint64 last)
+{
+    guint64      count, lo, result;
+    unsigned int k, tries, slack;
+
+    slack = sp->depth / 8;
+    k = sp->levels - 1;
+    for (tries = 0; tries < 10; ++tries) {
+        count = readable(sp, &lo, slack);
+        if (count == 0)
+            return SCOPE_NONE;
+        if (last >= count)
+            last = count - 1;
+        if (last <= lo)
+            return SCOPE_NONE;
+        result = find_rise(sp, k, lo >> (SCOPE_FAN_SHIFT * k),
+                           last >> (SCOPE_FAN_SHIFT * k), level, lo, last);
+        if (still_valid(sp, count, slack))
+            return result;
+    }
+    return SCOPE_NONE;
+}
@@ -19,6 +19,12 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include <glib.h>
 
 #include "sim.h"
@@ -27,13 +33,220 @@
 
 /* Simulator-side interface to the Blink library. */
 
-/* Static (for now) pointer to the simulator's functions. */
+/* A watch, see below. */
+
+struct watch {
+    struct blink_condition  cond;
+    guint64                 last;       /* Low value word when last tested. */
+    gboolean                used;
+};
+
+/* Values given by threads other than the simulation thread, see below. */
+
+struct update {
+    struct reg         *rp;
+    unsigned int        seq;            /* From rp->seq. */
+    unsigned int        what;           /* An enum kind. */
+    unsigned int        word;           /* Index of first value word. */
+};
+
+struct producer {
+    struct producer    *next;
+    struct blink_ctx   *ctx;
+    gint                in_use;         /* See release_producer(). */
+    GMutex              lock;           /* Held briefly by both sides. */
+    struct update      *updates;
+    unsigned int        count, size;
+    guint64            *words;
+    unsigned int        words_used, words_size;
+};
+
+/* Data private to this file, for each context.  Most are named below by
+ * macros, with their descriptions.
+ */
+
+struct sim_state {
+    const struct simulator_calls *sfp;
+    int                         (*push_wide)(Sim_RH, const uint64_t *);
+    int                         (*push_batch)(const struct blink_edit *,
+                                              size_t);
+    GHashTable                   *ght;
+    struct reg                  **reg_table;
+    unsigned int                  reg_count, reg_table_size;
+    guint64                       burst_given;
+    gboolean                      exact_time;
+    unsigned int                  history_depth;
+    unsigned int                  update_depth;
+    struct reg                   *batch_head, *batch_tail;
+    char                         *arena_next, *arena_end, *arena_last;
+    char                         *arena_blocks;
+    int                           notify_fd, notify_write_fd;
+    struct watch                  watches[BLINK_WATCHES];
+    GMutex                        watch_lock;
+    gint                          watch_hit;
+    guint64                      *push_words;
+    unsigned int                  push_size;
+    struct blink_edit            *edits;
+    unsigned int                  edit_count, edits_size;
+    guint64                      *edit_words;
+    unsigned int                  edit_words_used, edit_words_size;
+    gint64                        pace_start;
+    guint64                       pace_given;
+    unsigned int                  pace_rate;
+    gint64                        burst_returned;
+    unsigned int                  cycles;       /* Current burst count. */
+    int                           went;         /* Copy of cp->go. */
+    int                           first;        /* No pause after button. */
+    gboolean                      started;      /* Blink_run_control(). */
+    gboolean                      finished;     /* After sim_done(). */
+    const void                   *sim_thread;
+    struct producer              *producers;
+    struct producer               merge;
+};
+
+#define SIM_STATE_INIT {.notify_fd = -1, .notify_write_fd = -1, \
+                        .watch_hit = -1}
+
+/* The main context, and the calling thread's context. */
+
+static struct sim_state          Main_state = SIM_STATE_INIT;
+struct blink_ctx                 Main_ctx = {.sim = &Main_state};
+THREAD_LOCAL struct blink_ctx   *Ctx = &Main_ctx;
+
+/* Changes for the simulator to notice, see Blink_changes(), and the
+ * descriptors from Blink_get_fd(): an eventfd, or the ends of a pipe.
+ */
+
+static struct blink_generation Generation;
+#define Notify_fd (Ctx->sim->notify_fd)
+#define Notify_write_fd (Ctx->sim->notify_write_fd)
 
-static const struct simulator_calls *Sfp;
+/* Pointer to the simulator's functions, and optional extras. */
+
+#define Sfp (Ctx->sim->sfp)
+#define Push_wide (Ctx->sim->push_wide)
+#define Push_batch (Ctx->sim->push_batch)
 
 /* Hash table for Sim_RH handles to display structs. */
 
-static GHashTable *GHt;
+#define GHt (Ctx->sim->ght)
+
+/* Table of registers indexed by Blink_RID, one entry for each handle.
+ * The UI may read it, so old copies are left in place when it grows.
+ */
+
+#define Reg_table (Ctx->sim->reg_table)
+#define Reg_count (Ctx->sim->reg_count)
+#define Reg_table_size (Ctx->sim->reg_table_size)
+
+/* Simulated time, in cycles, for history entries, is Sim_time.  It is
+ * advanced by each burst from Blink_run_control() unless set by
+ * Blink_set_cycle().
+ */
+
+#define Burst_given (Ctx->sim->burst_given)
+#define Exact_time (Ctx->sim->exact_time)
+
+/* History depth for new registers. */
+
+#define History_depth (Ctx->sim->history_depth)
+
+#define WAVE_HISTORY 1024       /* Depth when only needed for a waveform. */
+
+/* Nesting depth of Blink_begin_update(), and the private list of registers
+ * changed since the outermost call.  Simulation thread only.
+ */
+
+#define Update_depth (Ctx->sim->update_depth)
+#define Batch_head (Ctx->sim->batch_head)
+#define Batch_tail (Ctx->sim->batch_tail)
+
+/* The simulation thread, see "Updates from several threads" below. */
+
+#define Sim_thread (Ctx->sim->sim_thread)
+
+static THREAD_LOCAL char This_thread;  /* Its address is an ID. */
+
+/* Things, their names and container lists live as long as the panel,
+ * so they are carved from large blocks and never freed.  Only the
+ * simulation thread allocates.
+ */
+
+#define ARENA_BLOCK (64 * 1024)
+#define ARENA_ALIGN 16
+
+#define Arena_next (Ctx->sim->arena_next)
+#define Arena_end (Ctx->sim->arena_end)
+#define Arena_last (Ctx->sim->arena_last) /* Most recent allocation. */
+
+/* Every block is listed, through a pointer at its start, so that
+ * Blink_free_context() can release them.
+ */
+
+#define Arena_blocks (Ctx->sim->arena_blocks)
+
+static char *arena_block(size_t size)
+{
+    char *block;
+
+    block = malloc(ARENA_ALIGN + size);
+    if (!block) {
+        fprintf(stderr, "No memory for display structures.\n");
+        exit(1);
+    }
+    *(char **)block = Arena_blocks;
+    Arena_blocks = block;
+    return block + ARENA_ALIGN;
+}
+
+static void *arena_alloc(size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > (size_t)(Arena_end - Arena_next)) {
+        /* Large requests get their own block, leaving the current one. */
+
+        if (size > ARENA_BLOCK / 4)
+            return arena_block(size);
+        Arena_next = arena_block(ARENA_BLOCK);
+        Arena_end = Arena_next + ARENA_BLOCK;
+    }
+    Arena_last = Arena_next;
+    Arena_next += size;
+    return Arena_last;
+}
+
+/* Resize an arena allocation.  The latest one is extended in place
+ * if there is room, otherwise the contents are copied.
+ */
+
+static void *arena_grow(void *old, size_t old_size, size_t new_size)
+{
+    void *new;
+
+    new_size = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (old && old == Arena_last &&
+        new_size <= (size_t)(Arena_end - Arena_last)) {
+        Arena_next = Arena_last + new_size;
+        return old;
+    }
+    new = arena_alloc(new_size);
+    if (old)
+        memcpy(new, old, old_size);
+    return new;
+}
+
+static char *arena_strdup(const char *name)
+{
+    char   *copy;
+    size_t  len;
+
+    if (!name)
+        return NULL;
+    len = strlen(name) + 1;
+    copy = arena_alloc(len);
+    memcpy(copy, name, len);
+    return copy;
+}
 
 int Blink_init(const char                    *title,
                const struct simulator_calls  *calls,
@@ -42,10 +255,53 @@ int Blink_init(const char                    *title,
 {
     Sfp = calls;
     GHt = g_hash_table_new(NULL, NULL); /* Hash table gpointer->gpointer. */
+    Sim_thread = &This_thread;
     Start_Panel(title, unit_strings, initial_unit);
     return 1;
 }
 
+/* Add optional simulator functions. */
+
+void Blink_set_push_wide(int (*push_wide)(Sim_RH handle,
+                                          const uint64_t *words))
+{
+    Push_wide = push_wide;
+}
+
+void Blink_set_push_batch(int (*push_batch)(const struct blink_edit *edits,
+                                            size_t count))
+{
+    Push_batch = push_batch;
+}
+
+/* Make a context for another simulation. */
+
+Blink_ctx Blink_new_context(void)
+{
+    static const struct sim_state init = SIM_STATE_INIT;
+    struct blink_ctx             *ctx;
+
+    ctx = g_new0(struct blink_ctx, 1);
+    ctx->sim = g_new(struct sim_state, 1);
+    *ctx->sim = init;
+    g_mutex_init(&ctx->simulation_mutex);
+    g_cond_init(&ctx->simulation_waker);
+    g_mutex_init(&ctx->sim->watch_lock);
+    return ctx;
+}
+
+/* Select the calling thread's context, NULL for the main one. */
+
+void Blink_use_context(Blink_ctx ctx)
+{
+    Ctx = ctx ? ctx : &Main_ctx;
+}
+
+Blink_ctx Blink_get_context(void)
+{
+    return Ctx;
+}
+
 /* Return a name for a thing. */
 
 static const char *nameof(struct thing *it)
@@ -68,6 +324,11 @@ static const char *nameof(struct thing *it)
         if (!n)
             n = "[Unnamed overlay]";
         break;
+    case List:
+        n = it->u.list.name;
+        if (!n)
+            n = "[Unnamed list]";
+        break;
     default:
         n = "[Unknown thing]";
         break;
@@ -75,13 +336,17 @@ static const char *nameof(struct thing *it)
     return n;
 }
 
-/* Overflow error. */
+/* Make room for another item in a container's list, doubling its size. */
 
-static void overflow(struct thing *jar, struct thing *thing)
+static void *more_items(void *items, int *size)
 {
-    fprintf(stderr, "Attempt to add %s to %s: container is full.\n",
-            nameof(thing), nameof(jar));
-    exit(1);
+    int new_size;
+
+    new_size = *size ? 2 * *size : 8;
+    items = arena_grow(items, *size * sizeof (void *),
+                       new_size * sizeof (void *));
+    *size = new_size;
+    return items;
 }
 
 /* Add something to a container. */
@@ -91,11 +356,13 @@ void Blink_add_to_container(Blink_CH thing, Blink_CH jar)
     struct row     *row;
     struct grid    *grid;
     struct overlay *overlay;
+    struct list    *list;
+    struct reg     *reg;
 
     if (!jar) {
         /* Item complete, send to display thread. */
 
-        g_idle_add(New_thing_call, thing);     /* Pass it to the UI. */
+        Call_UI(New_thing_call, thing, G_PRIORITY_DEFAULT_IDLE); /* To UI. */
         return;
     }
 
@@ -106,22 +373,46 @@ void Blink_add_to_container(Blink_CH thing, Blink_CH jar)
         break;
     case Row:
         row = &jar->u.row;
-        if (row->count >= MAX_ITEMS)
-            overflow(jar, thing);        // No return.
+        if (row->count == row->size)
+            row->items = more_items(row->items, &row->size);
         row->items[row->count++] = thing;
         break;
     case Grid:
         grid = &jar->u.grid;
-        if (grid->count >= MAX_ITEMS)
-            overflow(jar, thing);        // No return.
+        if (grid->count == grid->size)
+            grid->items = more_items(grid->items, &grid->size);
         grid->items[grid->count++] = thing;
         break;
     case Overlay:
         overlay = &jar->u.overlay;
-        if (overlay->count >= MAX_ITEMS)
-            overflow(jar, thing);        // No return.
+        if (overlay->count == overlay->size)
+            overlay->items = more_items(overlay->items, &overlay->size);
         overlay->items[overlay->count++] = (GtkWidget *)thing;
         break;
+    case List:
+        if (thing->type != Register) {
+            fprintf(stderr, "Attempt to add %s to %s: "
+                    "lists may contain only registers.\n",
+                    nameof(thing), nameof(jar));
+            exit(1);
+        }
+
+        /* Listed registers are shown as text, and only when scrolled
+         * into view.  Until then, the simulator's updates need not
+         * be passed to the UI.
+         */
+
+        reg = &thing->u.reg;
+        reg->options |= RO_LISTED;
+        reg->u.e.max_len = 0;
+        reg->u.e.entry = NULL;
+        g_atomic_int_add(&reg->head->shown, -1);
+
+        list = &jar->u.list;
+        if (list->count == list->size)
+            list->items = more_items(list->items, &list->size);
+        list->items[list->count++] = thing;
+        break;
     default:
         fprintf(stderr, "Unknown thing of type %d passed as container.\n",
                 jar->type);
@@ -130,48 +421,287 @@ void Blink_add_to_container(Blink_CH thing, Blink_CH jar)
     }
 }
 
+/* Value history.  Each entry is the time followed by the value words.
+ * Only the simulation thread writes, without locking, so a reader checks
+ * the count afterwards to see whether the entries it used were
+ * overwritten, as in a seqlock.
+ */
+
+static struct history *new_history(unsigned int nwords, unsigned int depth)
+{
+    struct history *hp;
+    unsigned int    stride;
+
+    stride = 1 + nwords;
+    hp = arena_alloc(sizeof *hp + (size_t)depth * stride * sizeof (guint64));
+    hp->depth = depth;
+    hp->stride = stride;
+    hp->count = 0;
+    return hp;
+}
+
+static void record(struct reg *head, struct reg *rp)
+{
+    struct blink_ctx *Ctx = head->ctx;  /* See new_data(). */
+    struct history   *hp;
+    guint64          *entry, n;
+    unsigned int      i;
+
+    hp = head->history;
+    n = hp->count;
+    if (!History_begun) {
+        __atomic_store_n(&History_start, Sim_time, __ATOMIC_RELAXED);
+        g_atomic_int_set(&History_begun, TRUE);
+    }
+
+    /* Order the previous count update before the new entry. */
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry = hp->words + (n & (hp->depth - 1)) * hp->stride;
+    __atomic_store_n(entry, Sim_time, __ATOMIC_RELAXED);
+    if (rp->nwords == 0) {
+        memcpy(entry + 1, &rp->fp_value, sizeof (guint64));
+    } else {
+        for (i = 0; i < hp->stride - 1; ++i) {
+            __atomic_store_n(entry + 1 + i,
+                             i < rp->nwords ?
+                                 __atomic_load_n(reg_value(rp) + i,
+                                                 __ATOMIC_RELAXED) : 0,
+                             __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&hp->count, n + 1, __ATOMIC_RELEASE);
+}
+
+/* Find the last entry at or before a time, between entries lo and hi.
+ * Returns NO_ENTRY if the first is later.
+ */
+
+#define NO_ENTRY G_MAXUINT64
+
+static guint64 entry_at(struct history *hp, guint64 lo, guint64 hi,
+                        guint64 time)
+{
+    guint64 mid, *entry;
+
+    entry = hp->words + (lo & (hp->depth - 1)) * hp->stride;
+    if (__atomic_load_n(entry, __ATOMIC_RELAXED) > time)
+        return NO_ENTRY;
+    while (lo < hi) {
+        mid = hi - (hi - lo) / 2;
+        entry = hp->words + (mid & (hp->depth - 1)) * hp->stride;
+        if (__atomic_load_n(entry, __ATOMIC_RELAXED) <= time)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+/* Copy the value words of an entry. */
+
+static void copy_entry(struct history *hp, guint64 n, guint64 *words)
+{
+    guint64      *entry;
+    unsigned int  i;
+
+    entry = hp->words + (n & (hp->depth - 1)) * hp->stride;
+    for (i = 0; i < hp->stride - 1; ++i)
+        words[i] = __atomic_load_n(entry + 1 + i, __ATOMIC_RELAXED);
+}
+
+/* Find a register's value at a past time, for the UI.  If the time
+ * precedes the history, the oldest value is returned.
+ */
+
+gboolean History_at(struct reg *head, guint64 time, guint64 *words)
+{
+    struct history *hp;
+    guint64         count, lo, n;
+    unsigned int    tries, slack;
+
+    hp = __atomic_load_n(&head->history, __ATOMIC_ACQUIRE);
+    if (!hp)
+        return FALSE;
+    slack = hp->depth / 8 + 1;
+    for (tries = 0; tries < 10; ++tries) {
+        count = __atomic_load_n(&hp->count, __ATOMIC_ACQUIRE);
+        if (count == 0)
+            return FALSE;
+
+        /* Leave some entries for the writer to overwrite meanwhile. */
+
+        lo = (count > hp->depth - slack) ? count - (hp->depth - slack) : 0;
+        n = entry_at(hp, lo, count - 1, time);
+        copy_entry(hp, n == NO_ENTRY ? lo : n, words);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&hp->count, __ATOMIC_RELAXED) <
+                count + slack) {
+            return TRUE;
+        }
+    }
+    return FALSE;                       /* Writer too busy. */
+}
+
+/* Sample a register's history for a waveform of "columns" periods of
+ * "step" cycles, the last ending at "time".  Each column is classified by
+ * the number of entries made during it, found by binary search at its end,
+ * so the work depends on the number of columns, not on how often the value
+ * changed.  The value at the end of each run is copied to "words",
+ * stride - 1 words per run.  Returns the number of runs, or zero.
+ */
+
+unsigned int History_runs(struct reg *head, guint64 time, guint64 step,
+                          unsigned int columns, struct wave_run *runs,
+                          guint64 *words)
+{
+    struct history  *hp;
+    struct wave_run *rp;
+    guint64          count, lo, n, prev;
+    unsigned int     c, kind, nruns, tries, slack, vwords;
+
+    hp = __atomic_load_n(&head->history, __ATOMIC_ACQUIRE);
+    if (!hp || columns == 0 || step == 0)
+        return 0;
+    slack = hp->depth / 8 + 1;
+    vwords = hp->stride - 1;
+    for (tries = 0; tries < 10; ++tries) {
+        count = __atomic_load_n(&hp->count, __ATOMIC_ACQUIRE);
+        if (count == 0)
+            return 0;
+        lo = (count > hp->depth - slack) ? count - (hp->depth - slack) : 0;
+
+        /* Entry current at the start of the first column. */
+
+        if (columns > time / step)
+            prev = NO_ENTRY;
+        else
+            prev = entry_at(hp, lo, count - 1, time - columns * step);
+
+        rp = NULL;
+        nruns = 0;
+        for (c = 0; c < columns; ++c) {
+            if (columns - 1 - c > time / step)
+                n = NO_ENTRY;
+            else
+                n = entry_at(hp, lo, count - 1,
+                             time - (columns - 1 - c) * step);
+            if (n == NO_ENTRY)
+                kind = WAVE_NONE;
+            else if (n - (prev == NO_ENTRY ? lo - 1 : prev) > 1)
+                kind = WAVE_BUSY;
+            else
+                kind = WAVE_STEADY;
+
+            /* Extend the current run, or start another. */
+
+            if (rp && kind == rp->kind && (kind == WAVE_BUSY || n == prev)) {
+                ++rp->length;
+            } else {
+                if (rp && prev != NO_ENTRY)
+                    copy_entry(hp, prev, words + (nruns - 1) * vwords);
+                rp = runs + nruns++;
+                rp->start = c;
+                rp->length = 1;
+                rp->kind = kind;
+            }
+            prev = n;
+        }
+        if (prev != NO_ENTRY)
+            copy_entry(hp, prev, words + (nruns - 1) * vwords);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&hp->count, __ATOMIC_RELAXED) <
+                count + slack) {
+            return nruns;
+        }
+    }
+    return 0;                           /* Writer too busy. */
+}
+
+/* Allow the UI to find all registers. */
+
+struct reg **Register_table(unsigned int *countp)
+{
+    *countp = g_atomic_int_get(&Reg_count);
+    return g_atomic_pointer_get(&Reg_table);
+}
+
+/* Set history depth for registers created later. */
+
+void Blink_set_history(unsigned int depth)
+{
+    unsigned int size;
+
+    for (size = depth ? 2 : 0; size && size < depth; size <<= 1)
+        ;
+    History_depth = size;
+}
+
+/* Set the current simulated time. */
+
+void Blink_set_cycle(uint64_t cycle)
+{
+    Exact_time = TRUE;
+    __atomic_store_n(&Sim_time, cycle, __ATOMIC_RELAXED);
+}
+
 static struct thing *new_register(const char *name, Sim_RH handle,
                                   unsigned int width, unsigned int options)
 {
     struct thing *this, *old;
     struct reg   *reg, *head;
-    unsigned int  button_count, type;
+    unsigned int  type, nwords, word_sets;
+    size_t        size;
     gboolean      is_fp;
 
     /* Check options for consistency. */
 
-    if (options & RO_STYLE_MASK) {
+    type = (options & RO_STYLE_MASK);
+    is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
+    if (!is_fp)
+        options &= ~RO_SCOPE;
+    if (type) {
         options &= ~(RO_SENSITIVITY | RO_ALT_COLOURS);
-        button_count = 0;
+        word_sets = 3;                  /* Value, flags and activity. */
     } else {
-        button_count = width;
+        word_sets = 6;                  /* And the copies shown. */
     }
+    nwords = is_fp ? 0 : REG_WORDS(width);
 
-    /* Create structure. */
+    /* Create structure, with the value words at the end. */
 
-    this = malloc(REGISTER_BASE_SIZE +
-                      ((sizeof reg->u.b.buttons[0]) * button_count));
-    if (!this)
-        return NULL;
+    size = REGISTER_BASE_SIZE;
+    size = (size + sizeof (guint64) - 1) & ~(sizeof (guint64) - 1);
+    this = arena_alloc(size + word_sets * nwords * sizeof (guint64));
     this->type = Register;
     reg = &this->u.reg;
     reg->width = width;
+    reg->nwords = nwords;
     reg->options = options;
-    type = (options & RO_STYLE_MASK);
-    is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
     if (is_fp) {
         reg->fp_value = 0.0;
     } else {
-        reg->u_value = 0;
-        reg->u_flags = 0;
+        reg->v.words = (guint64 *)((char *)this + size);
+        memset(reg->v.words, 0, word_sets * nwords * sizeof (guint64));
+        if (type == RO_STYLE_BITS)
+            reg->u.b.prev = reg->v.words + 3 * nwords;
+    }
+    if (type == RO_STYLE_WAVE) {
+        reg->u.w.max_len = 0;
+        reg->u.w.area = NULL;
+        reg->u.w.shift = -1;
     }
     reg->state = Valid;
+    reg->dirty = 0;
+    reg->history = NULL;
+    reg->scope = NULL;
+    reg->watched = 0;
     reg->clones = reg;          /* Circular list. */
-    if (name)
-        reg->name = strdup(name);
-    else
-        reg->name = NULL;
+    reg->name = arena_strdup(name);
     reg->handle = handle;
+    reg->ctx = Ctx;
 
     /* Hook the reg structure to the hash table. */
 
@@ -203,26 +733,73 @@ static struct thing *new_register(const char *name, Sim_RH handle,
 
         reg->clones = head->clones;
         head->clones = reg;
+        reg->head = head;
+        reg->id = head->id;
+        g_atomic_int_inc(&head->shown);
+        if (type == RO_STYLE_WAVE && !head->history) {
+            __atomic_store_n(&head->history,
+                             new_history(head->nwords, WAVE_HISTORY),
+                             __ATOMIC_RELEASE);
+            record(head, head);
+        }
+        if ((options & RO_SCOPE) && !head->scope)
+            __atomic_store_n(&head->scope, Scope_new(), __ATOMIC_RELEASE);
     } else {
+        /* New handle: add to the hash table and the ID table. */
+
+        if (Reg_count == Reg_table_size) {
+            struct reg **table;
+
+            table = arena_grow(Reg_table,
+                               Reg_table_size * sizeof Reg_table[0],
+                               2 * Reg_table_size * sizeof Reg_table[0] +
+                                   64 * sizeof Reg_table[0]);
+            Reg_table_size = 2 * Reg_table_size + 64;
+            g_atomic_pointer_set(&Reg_table, table);
+        }
+        reg->head = reg;
+        reg->shown = 1;
+        if (History_depth) {
+            reg->history = new_history(nwords ? nwords : 1, History_depth);
+        } else if (type == RO_STYLE_WAVE) {
+            reg->history = new_history(nwords, WAVE_HISTORY);
+        }
+        if (reg->history)
+            record(reg, reg);           /* The initial value. */
+        if (options & RO_SCOPE)
+            reg->scope = Scope_new();
+        reg->id = Reg_count;
+        Reg_table[Reg_count] = reg;
+        g_atomic_int_set(&Reg_count, Reg_count + 1);
         g_hash_table_insert(GHt, (gpointer)handle, this);
     }
     return this;
 }
 
-/* Add a register.*/
+/* Add a register, returning its ID. */
 
-void Blink_add_register(const char *name, Sim_RH handle, unsigned int width,
-                        unsigned int options, Blink_CH container)
+Blink_RID Blink_add_register_id(const char *name, Sim_RH handle,
+                                unsigned int width, unsigned int options,
+                                Blink_CH container)
 {
     struct thing *thing;
 
     thing = new_register(name, handle, width, options);
     if (!thing)
-        return;
+        return -1;
     if (container)
         Blink_add_to_container(thing, container);
     else
-        g_idle_add(New_thing_call, thing);     /* Pass it to the UI. */
+        Call_UI(New_thing_call, thing, G_PRIORITY_DEFAULT_IDLE); /* To UI. */
+    return thing->u.reg.id;
+}
+
+/* Add a register.*/
+
+void Blink_add_register(const char *name, Sim_RH handle, unsigned int width,
+                        unsigned int options, Blink_CH container)
+{
+    (void)Blink_add_register_id(name, handle, width, options, container);
 }
 
 /* Start a new row. */
@@ -232,13 +809,13 @@ Blink_CH Blink_new_row(const char *name)
     struct thing *thing;
     struct row   *row;
 
-    thing = (struct thing *)malloc(ROW_BASE_SIZE);
-    if (!thing)
-        return NULL;
+    thing = (struct thing *)arena_alloc(ROW_BASE_SIZE);
     thing->type = Row;
     row = &thing->u.row;
-    row->name = name ? strdup(name) : NULL;
+    row->name = arena_strdup(name);
     row->count = 0;
+    row->size = 0;
+    row->items = NULL;
     return thing;
 }
 
@@ -251,21 +828,40 @@ Blink_CH Blink_new_overlay(const char *name)
     struct thing   *thing;
     struct overlay *this;
 
-    thing = (struct thing *)malloc(OVERLAY_BASE_SIZE);
-    if (!thing) {
-        fprintf(stderr, "No memory for overlayed register display %s\n", name);
-        exit(1);
-    }
+    thing = (struct thing *)arena_alloc(OVERLAY_BASE_SIZE);
     thing->type = Overlay;
 
     this = &thing->u.overlay;
-    this->name = name ? strdup(name) : NULL;
+    this->name = arena_strdup(name);
     this->choice = 0;
     this->count = 0;
+    this->size = 0;
+    this->items = NULL;
     this->stack = 0;
     return thing;
 }
 
+/* Start a scrolling list. */
+
+Blink_CH Blink_new_list(const char *name, int rows)
+{
+    struct thing *thing;
+    struct list  *list;
+
+    thing = (struct thing *)arena_alloc(LIST_BASE_SIZE);
+    thing->type = List;
+    list = &thing->u.list;
+    list->name = arena_strdup(name);
+    list->rows = rows > 0 ? rows : 1;
+    list->count = 0;
+    list->size = 0;
+    list->first = 0;
+    list->adj = NULL;
+    list->slots = NULL;
+    list->items = NULL;
+    return thing;
+}
+
 /* Start a new grid. */
 
 Blink_CH Blink_new_grid(const char *name, int columns)
@@ -273,22 +869,37 @@ Blink_CH Blink_new_grid(const char *name, int columns)
     struct thing *thing;
     struct grid   *grid;
 
-    thing = (struct thing *)malloc(GRID_BASE_SIZE);
-    if (!thing)
-        return NULL;
+    thing = (struct thing *)arena_alloc(GRID_BASE_SIZE);
     thing->type = Grid;
     grid = &thing->u.grid;
-    grid->name = name ? strdup(name) : NULL;
+    grid->name = arena_strdup(name);
     grid->columns = columns;
     grid->count = 0;
+    grid->size = 0;
+    grid->items = NULL;
     return thing;
 }
 
-/* When the window is closed, this function is called in the simulation thread.
+/* When the window is closed, or a headless run ends, this function is called
+ * in the simulation thread.  For the main context it does not return.
+ * Other simulations end without the process, so it returns 1, which
+ * gives a zero burst, as do all later calls of Blink_run_control().
  */
 
-static void do_exit(void)
+static int do_exit(void)
 {
+    if (Ctx != &Main_ctx) {
+        if (!Ctx->sim->finished) {
+            Ctx->sim->finished = TRUE;
+            Blink_trace_stop();
+            Capture_stop();
+            if (Sfp->sim_done)
+                Sfp->sim_done();
+        }
+        return 1;
+    }
+    Blink_trace_stop();
+    Capture_stop();
     if (Sfp->sim_done)
         Sfp->sim_done();
     exit(0);
@@ -308,10 +919,12 @@ void Blink_change_overlay(Blink_CH thing, int value)
     if (this->choice == value || value < 0 || value >= this->count)
         return;
     this->choice = value;
-    g_idle_add(Overlay_switch, this);
+    Call_UI(Overlay_switch, this, G_PRIORITY_DEFAULT_IDLE);
 }
 
-static struct reg *reg_from_handle(Sim_RH handle)
+/* Look up a handle in the context given, which the macros then name. */
+
+static struct reg *handle_reg(struct blink_ctx *Ctx, Sim_RH handle)
 {
     struct thing *thing;
 
@@ -327,117 +940,738 @@ static struct reg *reg_from_handle(Sim_RH handle)
     return &thing->u.reg;
 }
 
-enum kind {i_value, f_value, flags};
-
-static void new_data(Sim_RH handle, enum kind what, void *vp)
+static struct reg *reg_from_handle(Sim_RH handle)
 {
-    struct reg   *rp;
-    unsigned int  type;
-    gboolean      is_fp, bad, go;
-
-    rp = reg_from_handle(handle);
-    type = (rp->options & RO_STYLE_MASK);
-    is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
-    bad = FALSE;
-    go = TRUE;
+    return handle_reg(Ctx, handle);
+}
 
-    /* Update the field ... */
+/* Array lookup of an ID.  Compile with -DDEBUG to check it. */
 
-    g_mutex_lock(&Simulation_mutex);
-    go = (rp->state != User);
-    if (go) {
-        
-        /* ... if no user update pending. */
+static inline struct reg *id_reg(struct blink_ctx *Ctx, Blink_RID id)
+{
+#ifdef DEBUG
+    if (id < 0 || (unsigned int)id >= Reg_count) {
+        fprintf(stderr, "Unknown register ID %d.\n", id);
+        exit(1);
+    }
+#endif
+    return Reg_table[id];
+}
 
-        switch (what) {
-        case i_value:
-            if (is_fp)
-                bad = TRUE;
-            else if (rp->u_value != *(unsigned int *)vp)
-                rp->u_value = *(unsigned int *)vp;
-            else
-                go = FALSE;
-            break;
-        case f_value:
-            if (!is_fp)
-                bad = TRUE;
-            else if (rp->fp_value != *(double *)vp)
-                rp->fp_value = *(double *)vp;
-            else
-                go = FALSE;
-            break;
-        case flags:
-            if (is_fp)
-                bad = TRUE;
-            else if (rp->u_flags != *(unsigned int *)vp)
-                rp->u_flags = *(unsigned int *)vp;
-            else
-                go = FALSE;
-            break;
-        }
-        if (!bad && go && rp->state != Simulation) {
-            rp->state = Simulation;
+enum kind {i_value, w_value, f_value, flags, w_flags};
 
-            /* Beware deadlock. */
+/* Store the words of a new value or flags, clearing any beyond the count
+ * supplied.  Returns TRUE if anything changed.  For a value, the bits
+ * that changed are added to "activity", so that the UI can show a pulse
+ * that came and went between frames.
+ */
 
-            g_mutex_unlock(&Simulation_mutex);
-            g_idle_add_full(G_PRIORITY_LOW,
-                            what == flags ? Flag_call : Simulation_call,
-                            (gpointer)rp,
-                            NULL);
-            return;
+static gboolean store_words(guint64 *dest, unsigned int size,
+                            const guint64 *src, unsigned int count,
+                            guint64 *activity)
+{
+    unsigned int i;
+    guint64      old, new;
+    gboolean     changed;
+
+    for (changed = FALSE, i = 0; i < size; ++i) {
+        new = (i < count) ? src[i] : 0;
+        old = get_word(dest + i);
+        if (old != new) {
+            set_word(dest + i, new);
+            if (activity)
+                __atomic_fetch_or(activity + i, old ^ new, __ATOMIC_RELAXED);
+            changed = TRUE;
         }
     }
-    g_mutex_unlock(&Simulation_mutex);
-    if (bad) {
-        fprintf(stderr, "Ignored incorrect data (type %d) for register %s.\n",
-                (int)what, rp->name);
-    }
+    return changed;
 }
 
-/* The simulator has produced a new register value. */
+/* Put a register on the list for display at the next frame, unless
+ * it is already there.  The list is lock-free: registers are pushed
+ * here and the UI thread takes the whole list at once.  Inside
+ * Blink_begin_update(), they go on a private list instead.
+ */
 
-void Blink_new_value(Sim_RH handle, unsigned int value)
+static void mark_dirty(struct reg *rp, unsigned int bits)
 {
-    new_data(handle, i_value, &value);
+    struct blink_ctx *Ctx = rp->ctx;    /* Not the thread's, see new_data(). */
+    struct reg       *head;
+
+    if (g_atomic_int_or(&rp->dirty, bits))
+        return;                         /* Already listed. */
+    if (Update_depth) {
+        if (!Batch_head)
+            Batch_tail = rp;
+        rp->dirty_chain = Batch_head;
+        Batch_head = rp;
+        return;
+    }
+    do {
+        head = g_atomic_pointer_get(&Dirty_regs);
+        rp->dirty_chain = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&Dirty_regs, head, rp));
+    if (!head)
+        Wake_display(Ctx);
 }
 
-void Blink_new_FP(Sim_RH handle, double value)
+/* Test a condition, given the previous and current low value words. */
+
+gboolean Condition_met(const struct blink_condition *cp,
+                       guint64 old, guint64 now)
 {
-    new_data(handle, f_value, &value);
+    switch (cp->kind) {
+    case BLINK_COND_MATCH:
+        return (now & cp->mask) == cp->match;
+    case BLINK_COND_RISE:
+        return (~old & now & cp->mask) != 0;
+    case BLINK_COND_FALL:
+        return (old & ~now & cp->mask) != 0;
+    case BLINK_COND_CHANGE:
+        return ((old ^ now) & cp->mask) != 0;
+    case BLINK_COND_RANGE:
+        return (now & cp->mask) >= cp->match && (now & cp->mask) <= cp->limit;
+    default:
+        return FALSE;
+    }
 }
 
-/* The simulator has produced a new flag value. */
+/* Watches.  They may be set from either thread, so changes to the table
+ * are locked, as are tests, which are made only for registers watched.
+ * Watch_hit is the first watch met since the last burst, or -1.
+ */
 
-void Blink_new_flags(Sim_RH handle, unsigned int value)
+#define Watches (Ctx->sim->watches)
+#define Watch_lock (Ctx->sim->watch_lock)
+#define Watch_hit (Ctx->sim->watch_hit)
+
+/* These two are called with Watch_lock held. */
+
+static int add_watch(const struct blink_condition *cond)
+{
+    struct reg   *rp;
+    int           i;
+
+    if ((unsigned int)cond->id >= Reg_count || cond->kind > BLINK_COND_RANGE)
+        return -1;
+    rp = Reg_table[cond->id];
+    if (rp->nwords == 0)
+        return -1;                      /* Floating-point. */
+    for (i = 0; i < BLINK_WATCHES; ++i) {
+        if (!Watches[i].used) {
+            Watches[i].cond = *cond;
+            Watches[i].last = get_word(reg_value(rp));
+            Watches[i].used = TRUE;
+            __atomic_add_fetch(&rp->watched, 1, __ATOMIC_RELAXED);
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_watch(int watch)
 {
-    new_data(handle, flags, &value);
+    if (Watches[watch].used) {
+        Watches[watch].used = FALSE;
+        __atomic_sub_fetch(&Reg_table[Watches[watch].cond.id]->watched, 1,
+                           __ATOMIC_RELAXED);
+    }
 }
 
-/* Pass a table of strings to be used in a GtkComboBoxText widget.
- * The selection is treated as an integer "register.
- */
+int Blink_add_watch(const struct blink_condition *cond)
+{
+    int watch;
 
-void Blink_new_strings(Sim_RH handle, const char * const *table)
+    g_mutex_lock(&Watch_lock);
+    watch = add_watch(cond);
+    g_mutex_unlock(&Watch_lock);
+    return watch;
+}
+
+void Blink_remove_watch(int watch)
 {
-    struct reg  *rp;
+    int i;
 
-    rp = reg_from_handle(handle);
-    if ((rp->options & RO_STYLE_MASK) != RO_STYLE_COMBO) {
-        fprintf(stderr, "Strings supplied for non-combo-box item %s\n",
-                rp->name);
+    if (watch >= BLINK_WATCHES)
         return;
+    g_mutex_lock(&Watch_lock);
+    if (watch >= 0) {
+        remove_watch(watch);
+    } else {
+        for (i = 0; i < BLINK_WATCHES; ++i)
+            remove_watch(i);
     }
+    g_mutex_unlock(&Watch_lock);
+}
 
-    /* Update the field ... */
+int Blink_watch_hit(void)
+{
+    return g_atomic_int_get(&Watch_hit);
+}
 
-    g_mutex_lock(&Simulation_mutex);
-    rp->u.e.strings = table;
-    g_mutex_unlock(&Simulation_mutex);
-    g_idle_add_full(G_PRIORITY_LOW, New_strings_call, (gpointer)rp, NULL);
+int Toggle_watch(const struct blink_condition *cond)
+{
+    struct watch *wp;
+    int           i, count;
+
+    g_mutex_lock(&Watch_lock);
+    for (i = 0; i < BLINK_WATCHES; ++i) {
+        wp = Watches + i;
+        if (wp->used && wp->cond.id == cond->id &&
+            wp->cond.kind == cond->kind && wp->cond.mask == cond->mask &&
+            wp->cond.match == cond->match && wp->cond.limit == cond->limit) {
+            break;
+        }
+    }
+    if (i < BLINK_WATCHES)
+        remove_watch(i);
+    else
+        add_watch(cond);
+    for (count = 0, i = 0; i < BLINK_WATCHES; ++i)
+        count += Watches[i].used;
+    g_mutex_unlock(&Watch_lock);
+    return count;
 }
 
-/* Store and retrieve a Blink handle. */
+/* A watched register's value changed. */
+
+static void count_change(struct blink_ctx *Ctx);
+
+static void test_watches(struct reg *rp)
+{
+    struct blink_ctx *Ctx = rp->ctx;    /* See new_data(). */
+    struct watch     *wp;
+    guint64           now;
+    int               i;
+
+    now = get_word(reg_value(rp));
+    g_mutex_lock(&Watch_lock);
+    for (i = 0; i < BLINK_WATCHES; ++i) {
+        wp = Watches + i;
+        if (!wp->used || wp->cond.id != rp->id)
+            continue;
+        if (Condition_met(&wp->cond, wp->last, now) &&
+            g_atomic_int_get(&Watch_hit) < 0) {
+            Watch_time = Sim_time;
+            g_atomic_int_set(&Watch_hit, i);
+            count_change(Ctx);
+        }
+        wp->last = now;
+    }
+    g_mutex_unlock(&Watch_lock);
+}
+
+/* At the start of a burst: stop the run if a watch was met. */
+
+static gboolean watch_stop(struct run_control *rcp)
+{
+    int watch;
+
+    watch = g_atomic_int_get(&Watch_hit);
+    if (watch < 0)
+        return FALSE;
+    g_atomic_int_set(&Watch_hit, -1);
+    The_clock.run = 0;
+    The_clock.turbo = 0;
+    The_clock.go = 0;
+    Call_UI(Show_stopped, GINT_TO_POINTER(watch + 1), G_PRIORITY_DEFAULT);
+    rcp->unit = The_clock.unit;
+    rcp->rate = The_clock.rate;
+    rcp->burst = 0;
+    return TRUE;
+}
+
+/* Updates from several threads.  The thread that last called Blink_init()
+ * or Blink_run_control() is the simulation thread, and its values are
+ * stored at once.  Any other thread keeps its values in a buffer of its
+ * own, so that threads do not wait for each other, and the simulation
+ * thread applies all of them at the start of the next burst.  Each
+ * value is numbered from a count in its register, so that when several
+ * threads set the same register, the last to do so wins.
+ */
+
+#define Producers (Ctx->sim->producers)
+
+static THREAD_LOCAL struct producer *Producer;
+
+static inline gboolean on_sim_thread(void)
+{
+    return __atomic_load_n(&Sim_thread, __ATOMIC_RELAXED) == &This_thread;
+}
+
+/* When a thread ends, its buffer is left for the next new one.  A buffer
+ * is free (in_use zero), claimed by a live thread (one) or claimed when
+ * its context was released (two), when it is freed by the thread.
+ */
+
+static void release_producer(gpointer data)
+{
+    struct producer *pp;
+
+    pp = (struct producer *)data;
+    if (!g_atomic_int_compare_and_exchange(&pp->in_use, 1, 0)) {
+        g_mutex_clear(&pp->lock);
+        g_free(pp);
+    }
+}
+
+static GPrivate Producer_key = G_PRIVATE_INIT(release_producer);
+
+static struct producer *get_producer(struct blink_ctx *Ctx)
+{
+    struct producer *pp, *head;
+
+    for (pp = g_atomic_pointer_get(&Producers); pp; pp = pp->next) {
+        if (g_atomic_int_compare_and_exchange(&pp->in_use, 0, 1))
+            break;
+    }
+    if (!pp) {
+        pp = g_new0(struct producer, 1);
+        pp->ctx = Ctx;
+        pp->in_use = 1;
+        g_mutex_init(&pp->lock);
+        do {
+            head = g_atomic_pointer_get(&Producers);
+            pp->next = head;
+        } while (!g_atomic_pointer_compare_and_exchange(&Producers,
+                                                         head, pp));
+    }
+    g_private_replace(&Producer_key, pp); /* Releases any previous one. */
+    return pp;
+}
+
+/* Value words kept for an update. */
+
+static inline unsigned int update_words(struct reg *rp, enum kind what)
+{
+    return (what == w_value || what == w_flags) ? rp->nwords : 1;
+}
+
+/* Add an update to a buffer, with room for "nwords" value words. */
+
+static guint64 *add_update(struct producer *pp, struct reg *rp,
+                           enum kind what, unsigned int seq,
+                           unsigned int nwords)
+{
+    struct update *up;
+
+    if (pp->count == pp->size) {
+        pp->size = pp->size ? 2 * pp->size : 256;
+        pp->updates = g_renew(struct update, pp->updates, pp->size);
+    }
+    if (pp->words_used + nwords > pp->words_size) {
+        while (pp->words_used + nwords > pp->words_size)
+            pp->words_size = pp->words_size ? 2 * pp->words_size : 256;
+        pp->words = g_renew(guint64, pp->words, pp->words_size);
+    }
+    up = pp->updates + pp->count++;
+    up->rp = rp;
+    up->seq = seq;
+    up->what = what;
+    up->word = pp->words_used;
+    pp->words_used += nwords;
+    return pp->words + up->word;
+}
+
+/* Called by new_data() in a thread other than the simulation thread. */
+
+static void buffer_update(struct reg *rp, enum kind what, const void *vp)
+{
+    struct producer *pp;
+    guint64         *dest;
+    unsigned int     seq, nwords;
+
+    pp = Producer;
+    if (!pp || pp->ctx != rp->ctx)
+        Producer = pp = get_producer(rp->ctx);
+    nwords = update_words(rp, what);
+    g_mutex_lock(&pp->lock);
+    seq = __atomic_add_fetch(&rp->seq, 1, __ATOMIC_RELAXED);
+    dest = add_update(pp, rp, what, seq, nwords);
+    switch (what) {
+    case i_value:
+    case flags:
+        *dest = *(const unsigned int *)vp;
+        break;
+    case f_value:
+        memcpy(dest, vp, sizeof (double));
+        break;
+    default:
+        memcpy(dest, vp, nwords * sizeof (guint64));
+        break;
+    }
+    g_mutex_unlock(&pp->lock);
+}
+
+/* Order buffered updates by register, then by number. */
+
+static int update_order(const void *a, const void *b)
+{
+    const struct update *ua = a, *ub = b;
+
+    if (ua->rp->id != ub->rp->id)
+        return (ua->rp->id < ub->rp->id) ? -1 : 1;
+    return (int)(ua->seq - ub->seq);    /* Wraps safely. */
+}
+
+/* The number of the last value or flags stored.  Simulation thread only. */
+
+static inline unsigned int *stored_seq(struct reg *rp, enum kind what)
+{
+    return (what == flags || what == w_flags) ? &rp->seq_flags :
+                                                &rp->seq_value;
+}
+
+static void store_data(struct reg *rp, enum kind what, const void *vp);
+
+/* At the start of a burst: take every buffer's updates and apply them,
+ * published as one group.  An update numbered before the last stored
+ * for its register is out of date, as a buffer may be taken before an
+ * earlier update from another thread reaches its own.
+ */
+
+static void merge_updates(void)
+{
+    struct producer *pp, *mp;
+    struct update   *up;
+    unsigned int    *sp, i, n, value;
+    double           fp;
+
+    mp = &Ctx->sim->merge;
+    mp->count = mp->words_used = 0;
+    for (pp = g_atomic_pointer_get(&Producers); pp; pp = pp->next) {
+        if (!__atomic_load_n(&pp->count, __ATOMIC_RELAXED))
+            continue;
+        g_mutex_lock(&pp->lock);
+        for (i = 0; i < pp->count; ++i) {
+            up = pp->updates + i;
+            n = update_words(up->rp, up->what);
+            memcpy(add_update(mp, up->rp, up->what, up->seq, n),
+                   pp->words + up->word, n * sizeof (guint64));
+        }
+        pp->count = pp->words_used = 0;
+        g_mutex_unlock(&pp->lock);
+    }
+    if (mp->count == 0)
+        return;
+    qsort(mp->updates, mp->count, sizeof (struct update), update_order);
+    Blink_begin_update();
+    for (i = 0; i < mp->count; ++i) {
+        up = mp->updates + i;
+        sp = stored_seq(up->rp, up->what);
+        if ((int)(up->seq - *sp) <= 0)
+            continue;                   /* Superseded. */
+        *sp = up->seq;
+        switch (up->what) {
+        case i_value:
+        case flags:
+            value = (unsigned int)mp->words[up->word];
+            store_data(up->rp, up->what, &value);
+            break;
+        case f_value:
+            memcpy(&fp, mp->words + up->word, sizeof fp);
+            store_data(up->rp, up->what, &fp);
+            break;
+        default:
+            store_data(up->rp, up->what, mp->words + up->word);
+            break;
+        }
+    }
+    Blink_end_update();
+}
+
+static void store_data(struct reg *rp, enum kind what, const void *vp)
+{
+    struct blink_ctx *Ctx = rp->ctx;    /* Not the thread's, see new_data(). */
+    unsigned int      type;
+    guint64           word;
+    gboolean          is_fp, changed;
+
+    /* Ignore the simulator while a user update is pending. */
+
+    if (g_atomic_int_get(&rp->state) == User)
+        return;
+
+    type = (rp->options & RO_STYLE_MASK);
+    is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
+    if (is_fp != (what == f_value)) {
+        fprintf(stderr, "Ignored incorrect data (type %d) for register %s.\n",
+                (int)what, rp->name);
+        return;
+    }
+
+    /* Update the field, if changed. */
+
+    switch (what) {
+    case i_value:
+        word = *(unsigned int *)vp;
+        changed = store_words(reg_value(rp), rp->nwords, &word, 1,
+                              reg_activity(rp));
+        break;
+    case w_value:
+        changed = store_words(reg_value(rp), rp->nwords, vp, rp->nwords,
+                              reg_activity(rp));
+        break;
+    case f_value:
+        if (rp->scope)
+            Scope_add(rp->scope, *(double *)vp);
+        if (get_fp(rp) == *(double *)vp)
+            return;
+        set_fp(rp, *(double *)vp);
+        changed = TRUE;
+        break;
+    case flags:
+        word = *(unsigned int *)vp;
+        changed = store_words(reg_flags(rp), rp->nwords, &word, 1, NULL);
+        break;
+    case w_flags:
+        changed = store_words(reg_flags(rp), rp->nwords, vp, rp->nwords,
+                              NULL);
+        break;
+    default:
+        changed = FALSE;
+        break;
+    }
+    /* Only the value is needed while the register is out of view.
+     * The UI increments "shown" before reading a newly-visible value.
+     */
+
+    if (changed && rp->history)
+        record(rp, rp);
+    if (changed && Tracing && what != flags && what != w_flags)
+        Trace_change(rp);
+    if (changed && Capturing && what != flags && what != w_flags)
+        Capture_change(rp);
+    if (changed && __atomic_load_n(&rp->watched, __ATOMIC_RELAXED) &&
+        what != flags && what != w_flags) {
+        test_watches(rp);
+    }
+    if (changed && g_atomic_int_get(&rp->shown)) {
+        mark_dirty(rp,
+                   (what == flags || what == w_flags) ?
+                       DIRTY_FLAGS : DIRTY_VALUE);
+    }
+}
+
+/* Store a value or flags, or buffer them if not in the simulation thread.
+ * Once other threads have numbered updates for a register, the
+ * simulation thread's are numbered too, so that older buffered ones are
+ * dropped.  The register's context is used, rather than the thread's, so
+ * that the per-context names below cost no look-up of thread-local data,
+ * and so that a call for an explicit context, which may not be the
+ * thread's, is stored in its own.  The functions called from here do
+ * the same.
+ */
+
+static void new_data(struct reg *rp, enum kind what, const void *vp)
+{
+    struct blink_ctx *Ctx = rp->ctx;
+
+    if (G_UNLIKELY(__atomic_load_n(&Sim_thread, __ATOMIC_RELAXED) !=
+                   &This_thread)) {
+        buffer_update(rp, what, vp);
+        return;
+    }
+    if (G_UNLIKELY(__atomic_load_n(&rp->seq, __ATOMIC_RELAXED) != 0)) {
+        *stored_seq(rp, what) = __atomic_add_fetch(&rp->seq, 1,
+                                                   __ATOMIC_RELAXED);
+    }
+    store_data(rp, what, vp);
+}
+
+/* The simulator has produced a new register value.  Each value and flags
+ * call has a version for an explicit context, which the others call with
+ * the thread's.  These do not switch the thread's context, see
+ * blink_ctx.c, as the register names its own.
+ */
+
+void Blink_new_value_ctx(Blink_ctx ctx, Sim_RH handle, unsigned int value)
+{
+    new_data(handle_reg(ctx, handle), i_value, &value);
+}
+
+void Blink_new_value(Sim_RH handle, unsigned int value)
+{
+    Blink_new_value_ctx(Ctx, handle, value);
+}
+
+void Blink_new_FP_ctx(Blink_ctx ctx, Sim_RH handle, double value)
+{
+    new_data(handle_reg(ctx, handle), f_value, &value);
+}
+
+void Blink_new_FP(Sim_RH handle, double value)
+{
+    Blink_new_FP_ctx(Ctx, handle, value);
+}
+
+/* The simulator has produced a new flag value. */
+
+void Blink_new_flags_ctx(Blink_ctx ctx, Sim_RH handle, unsigned int value)
+{
+    new_data(handle_reg(ctx, handle), flags, &value);
+}
+
+void Blink_new_flags(Sim_RH handle, unsigned int value)
+{
+    Blink_new_flags_ctx(Ctx, handle, value);
+}
+
+/* The same, using register IDs. */
+
+void Blink_new_value_id_ctx(Blink_ctx ctx, Blink_RID id, unsigned int value)
+{
+    new_data(id_reg(ctx, id), i_value, &value);
+}
+
+void Blink_new_value_id(Blink_RID id, unsigned int value)
+{
+    Blink_new_value_id_ctx(Ctx, id, value);
+}
+
+void Blink_new_FP_id_ctx(Blink_ctx ctx, Blink_RID id, double value)
+{
+    new_data(id_reg(ctx, id), f_value, &value);
+}
+
+void Blink_new_FP_id(Blink_RID id, double value)
+{
+    Blink_new_FP_id_ctx(Ctx, id, value);
+}
+
+void Blink_new_flags_id_ctx(Blink_ctx ctx, Blink_RID id, unsigned int value)
+{
+    new_data(id_reg(ctx, id), flags, &value);
+}
+
+void Blink_new_flags_id(Blink_RID id, unsigned int value)
+{
+    Blink_new_flags_id_ctx(Ctx, id, value);
+}
+
+/* Values and flags for registers of any width. */
+
+void Blink_new_wide_value_ctx(Blink_ctx ctx, Sim_RH handle,
+                              const uint64_t *words)
+{
+    new_data(handle_reg(ctx, handle), w_value, words);
+}
+
+void Blink_new_wide_value(Sim_RH handle, const uint64_t *words)
+{
+    Blink_new_wide_value_ctx(Ctx, handle, words);
+}
+
+void Blink_new_wide_flags_ctx(Blink_ctx ctx, Sim_RH handle,
+                              const uint64_t *words)
+{
+    new_data(handle_reg(ctx, handle), w_flags, words);
+}
+
+void Blink_new_wide_flags(Sim_RH handle, const uint64_t *words)
+{
+    Blink_new_wide_flags_ctx(Ctx, handle, words);
+}
+
+void Blink_new_wide_value_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                 const uint64_t *words)
+{
+    new_data(id_reg(ctx, id), w_value, words);
+}
+
+void Blink_new_wide_value_id(Blink_RID id, const uint64_t *words)
+{
+    Blink_new_wide_value_id_ctx(Ctx, id, words);
+}
+
+void Blink_new_wide_flags_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                 const uint64_t *words)
+{
+    new_data(id_reg(ctx, id), w_flags, words);
+}
+
+void Blink_new_wide_flags_id(Blink_RID id, const uint64_t *words)
+{
+    Blink_new_wide_flags_id_ctx(Ctx, id, words);
+}
+
+/* Bulk updates, shown together. */
+
+void Blink_new_values(const Sim_RH *handles, const unsigned int *values,
+                      unsigned int count)
+{
+    unsigned int i;
+
+    Blink_begin_update();
+    for (i = 0; i < count; ++i)
+        new_data(reg_from_handle(handles[i]), i_value, values + i);
+    Blink_end_update();
+}
+
+void Blink_new_flags_bulk(const Sim_RH *handles, const unsigned int *values,
+                          unsigned int count)
+{
+    unsigned int i;
+
+    Blink_begin_update();
+    for (i = 0; i < count; ++i)
+        new_data(reg_from_handle(handles[i]), flags, values + i);
+    Blink_end_update();
+}
+
+/* Start and end a group of updates that are published as one. */
+
+void Blink_begin_update(void)
+{
+    if (on_sim_thread())                /* Others' updates wait anyway. */
+        ++Update_depth;
+}
+
+void Blink_end_update(void)
+{
+    struct reg *head;
+
+    if (!on_sim_thread() ||
+        Update_depth == 0 || --Update_depth > 0 || !Batch_head) {
+        return;
+    }
+
+    /* Splice the private list onto the shared one. */
+
+    do {
+        head = g_atomic_pointer_get(&Dirty_regs);
+        Batch_tail->dirty_chain = head;
+    } while (!g_atomic_pointer_compare_and_exchange(&Dirty_regs,
+                                                     head, Batch_head));
+    Batch_head = NULL;
+    if (!head)
+        Wake_display(Ctx);
+}
+
+/* Pass a table of strings to be used in a GtkComboBoxText widget.
+ * The selection is treated as an integer "register.
+ */
+
+void Blink_new_strings(Sim_RH handle, const char * const *table)
+{
+    struct reg  *rp;
+
+    rp = reg_from_handle(handle);
+    if ((rp->options & RO_STYLE_MASK) != RO_STYLE_COMBO) {
+        fprintf(stderr, "Strings supplied for non-combo-box item %s\n",
+                rp->name);
+        return;
+    }
+
+    /* Update the field ... */
+
+    g_mutex_lock(&Simulation_mutex);
+    rp->u.e.strings = table;
+    g_mutex_unlock(&Simulation_mutex);
+    Call_UI(New_strings_call, (gpointer)rp, G_PRIORITY_LOW);
+}
+
+/* Store and retrieve a Blink handle. */
 
 void Blink_store_handle(Blink_CH handle, Sim_RH key)
 {
@@ -467,80 +1701,186 @@ extern void Blink_sim_ctl(unsigned int ctl)
 {
     if (ctl != The_clock.sim_ctl) {
         The_clock.sim_ctl = ctl;
-        g_idle_add_full(G_PRIORITY_LOW, Display_burst, NULL, NULL);
+        Call_UI(Display_burst, NULL, G_PRIORITY_LOW);
     }
 }
 
 /* Push new values into the simulation. */
 
-static int push_changed_regs(void)
+#define Push_words (Ctx->sim->push_words) /* Copy of a wide value. */
+#define Push_size (Ctx->sim->push_size)
+
+/* Edits collected for the "push batch" function, with copies of their values.
+ * Until the batch is complete, the "words" members hold offsets in
+ * Edit_words, as it may move when enlarged.
+ */
+
+#define Edits (Ctx->sim->edits)
+#define Edit_count (Ctx->sim->edit_count)
+#define Edits_size (Ctx->sim->edits_size)
+#define Edit_words (Ctx->sim->edit_words)
+#define Edit_words_used (Ctx->sim->edit_words_used)
+#define Edit_words_size (Ctx->sim->edit_words_size)
+
+static void batch_edit(struct reg *rp)
 {
-    struct reg *rp;
-    int         rv = 0;
+    struct blink_edit *ep;
+    unsigned int       type, i;
 
-    g_mutex_lock(&Simulation_mutex);
-    for (;;) {
-        if (User_modified_regs == NULL) {
-            g_mutex_unlock(&Simulation_mutex);
-            return rv;
+    if (Edit_count >= Edits_size) {
+        Edits_size = Edits_size ? 2 * Edits_size : 16;
+        Edits = g_renew(struct blink_edit, Edits, Edits_size);
+    }
+    ep = Edits + Edit_count++;
+    ep->handle = rp->handle;
+    ep->value = 0;
+    ep->fp = 0.0;
+    ep->words = NULL;
+    ep->nwords = 0;
+    type = (rp->options & RO_STYLE_MASK);
+    if (rp->handle == COMBO_HANDLE) {
+        ep->handle = NULL;
+        ep->kind = BLINK_EDIT_UNIT;
+        ep->value = (unsigned int)get_word(reg_value(rp));
+    } else if (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN) {
+        ep->kind = BLINK_EDIT_FP;
+        ep->fp = get_fp(rp);
+    } else {
+        ep->kind = BLINK_EDIT_VALUE;
+        if (Edit_words_used + rp->nwords > Edit_words_size) {
+            Edit_words_size = 2 * (Edit_words_used + rp->nwords);
+            Edit_words = g_renew(guint64, Edit_words, Edit_words_size);
         }
+        for (i = 0; i < rp->nwords; ++i)
+            Edit_words[Edit_words_used + i] = get_word(reg_value(rp) + i);
+        ep->value = (unsigned int)Edit_words[Edit_words_used];
+        ep->words = (const uint64_t *)(uintptr_t)Edit_words_used;
+        ep->nwords = rp->nwords;
+        Edit_words_used += rp->nwords;
+    }
+}
 
-        /* Special case indicates window closure. */
+static int push_batch(void)
+{
+    unsigned int i;
+    int          rv;
 
-        if (User_modified_regs == EXIT_VALUE) {
-            do_exit();
-            return 0;
-        }
+    for (i = 0; i < Edit_count; ++i) {
+        if (Edits[i].kind == BLINK_EDIT_VALUE)
+            Edits[i].words = Edit_words + (uintptr_t)Edits[i].words;
+    }
+    rv = (*Push_batch)(Edits, Edit_count);
+    Edit_count = 0;
+    Edit_words_used = 0;
+    return rv;
+}
 
-        rp = User_modified_regs;
-        User_modified_regs = rp->chain;
-        if (rp->state == User) {
-            unsigned int type, is_fp, v;
-            double       fpv;
+static int push_changed_regs(void)
+{
+    struct reg *rp, *list, *next;
+    int         rv = 0;
 
-            v = is_fp = 0;                      // Silence gcc.
-            fpv = 0.0;
-            rp->state = Valid;
+    /* Take all pending edits at once. */
 
-            if (rp->handle == COMBO_HANDLE) {
-                v = rp->u_value;
-            } else {
-                type = (rp->options & RO_STYLE_MASK);
-                is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
-                if (is_fp)
-                    fpv = rp->fp_value;
-                else
-                    v = rp->u_value;
-            }
+    do {
+        list = g_atomic_pointer_get(&User_modified_regs);
+        if (list == EXIT_VALUE) {
+            /* Special case indicates window closure. */
 
-            /* Call back with mutex unlocked. */
+            return do_exit();
+        }
+    } while (!g_atomic_pointer_compare_and_exchange(&User_modified_regs,
+                                                     list, NULL));
+
+    /* Reverse the list, so that edits are delivered in order. */
 
-            g_mutex_unlock(&Simulation_mutex);
-            if (rp->handle == COMBO_HANDLE) {
-                /* Special case: combo-box changed. */
+    for (rp = NULL; list && list != EXIT_VALUE; list = next) {
+        next = list->chain;
+        list->chain = rp;
+        rp = list;
+    }
+    if (list == EXIT_VALUE)
+        return do_exit();
+
+    for (; rp; rp = next) {
+        unsigned int type, is_fp, v, i;
+        double       fpv;
+
+        /* The UI may queue the register again once its state is Valid,
+         * so get the link first, then the value.
+         */
+
+        next = rp->chain;
+        v = is_fp = 0;                      // Silence gcc.
+        fpv = 0.0;
+        g_atomic_int_set(&rp->state, Valid);
+        if (rp->handle != COMBO_HANDLE) {
+            if (rp->head->history)
+                record(rp->head, rp);
+            if (Tracing)
+                Trace_change(rp);
+            if (Capturing)
+                Capture_change(rp);
+        }
+        if (Push_batch) {
+            batch_edit(rp);
+            continue;
+        }
 
-                if (Sfp->sim_push_unit && (*Sfp->sim_push_unit)(v))
-                    rv = 1;
-            } else if (is_fp) {
-                if (Sfp->sim_push_fp(rp->handle, fpv))
-                    rv = 1;
+        if (rp->handle == COMBO_HANDLE) {
+            v = (unsigned int)get_word(reg_value(rp));
+        } else {
+            type = (rp->options & RO_STYLE_MASK);
+            is_fp = (type == RO_STYLE_FP || type == RO_STYLE_FP_SPIN);
+            if (is_fp) {
+                fpv = get_fp(rp);
+            } else if (rp->width > 32 && Push_wide) {
+                /* Take a copy, as the UI may change it again. */
+
+                if (rp->nwords > Push_size) {
+                    Push_size = rp->nwords;
+                    Push_words = realloc(Push_words,
+                                         Push_size * sizeof (guint64));
+                    if (!Push_words) {
+                        fprintf(stderr, "No memory for wide value.\n");
+                        exit(1);
+                    }
+                }
+                for (i = 0; i < rp->nwords; ++i)
+                    Push_words[i] = get_word(reg_value(rp) + i);
             } else {
-                if (Sfp->sim_push_val(rp->handle, v))
-                    rv = 1;
+                v = (unsigned int)get_word(reg_value(rp));
             }
-            g_mutex_lock(&Simulation_mutex);
+        }
+
+        if (rp->handle == COMBO_HANDLE) {
+            /* Special case: combo-box changed. */
+
+            if (Sfp->sim_push_unit && (*Sfp->sim_push_unit)(v))
+                rv = 1;
+        } else if (is_fp) {
+            if (Sfp->sim_push_fp(rp->handle, fpv))
+                rv = 1;
+        } else if (rp->width > 32 && Push_wide) {
+            if ((*Push_wide)(rp->handle, Push_words))
+                rv = 1;
+        } else {
+            if (Sfp->sim_push_val(rp->handle, v))
+                rv = 1;
         }
     }
+    if (Edit_count && push_batch())
+        rv = 1;
+    return rv;
 }
 
-/* Wait for a tick or wakeup.  Argument is frequency in units of 0.1 Hz. */
+/* Wait until a monotonic time or wakeup. */
 
-static int snooze(int tick)
+static int snooze_until(gint64 wake_time)
 {
-    gint64      wake_time;
     int         rv = 0;
 
-    if (User_modified_regs) {
+    if (EDITS_PENDING()) {
         rv = push_changed_regs();
         if (rv)
             return rv;
@@ -550,51 +1890,200 @@ static int snooze(int tick)
      * The mutex is released while sleeping, recovered on wake.
      */
 
-    wake_time = g_get_monotonic_time() + (10 * G_TIME_SPAN_SECOND) / tick;
     g_mutex_lock(&Simulation_mutex);
     g_cond_wait_until(&Simulation_waker, &Simulation_mutex, wake_time);
     g_mutex_unlock(&Simulation_mutex);
-    if (User_modified_regs)
+    if (EDITS_PENDING())
         rv = push_changed_regs();
     return rv;
 }
 
+/* Wait for a tick or wakeup.  Argument is frequency in units of 0.1 Hz. */
+
+static int snooze(int tick)
+{
+    return snooze_until(g_get_monotonic_time() +
+                        (10 * G_TIME_SPAN_SECOND) / tick);
+}
+
+/* Pacing of animation against the wall clock.  Cycle n is due at
+ * pace_time(n), counting from Pace_start at Pace_rate, in units of 0.1 Hz.
+ * As deadlines are absolute, time taken by the simulator and late
+ * wake-ups are made up and do not accumulate.  Above MAX_ANIMATED_RATE,
+ * the cycles due are given in one burst, waking at most every PACE_TICK
+ * rather than once per cycle.  A burst holds at most PACE_FRAME's worth
+ * of cycles, so that a late wake-up is made up over a few bursts without
+ * a long pause in the display.  If the simulator falls more than
+ * PACE_MAX_LAG behind, pacing restarts rather than catching up.
+ */
+
+#define PACE_TICK       (G_TIME_SPAN_SECOND / 100)
+#define PACE_FRAME      (G_TIME_SPAN_SECOND / 50)
+#define PACE_MAX_LAG    (G_TIME_SPAN_SECOND / 4)
+
+#define Pace_start (Ctx->sim->pace_start)
+#define Pace_given (Ctx->sim->pace_given) /* Cycles since Pace_start. */
+#define Pace_rate (Ctx->sim->pace_rate)
+
+static void pace_restart(gint64 now, unsigned int rate)
+{
+    Pace_start = now;
+    Pace_given = 0;
+    Pace_rate = rate;
+}
+
+/* Pace_given is kept below Pace_rate, so this does not overflow. */
+
+static gint64 pace_time(guint64 n)
+{
+    return Pace_start + (gint64)((n * 10 * G_TIME_SPAN_SECOND) / Pace_rate);
+}
+
+/* Cycles due by "now" but not yet given. */
+
+static guint64 pace_due(gint64 now)
+{
+    guint64 due;
+
+    if (now < Pace_start)
+        return 0;
+    due = ((guint64)(now - Pace_start) * Pace_rate) /
+              (10 * G_TIME_SPAN_SECOND) + 1;
+    return due > Pace_given ? due - Pace_given : 0;
+}
+
+/* Most cycles to give in one burst at the current rate. */
+
+static guint64 pace_limit(void)
+{
+    guint64 limit;
+
+    limit = ((guint64)PACE_FRAME * Pace_rate) / (10 * G_TIME_SPAN_SECOND);
+    return limit ? limit : 1;
+}
+
+/* Count cycles given, moving Pace_start forward every Pace_rate cycles. */
+
+static void pace_given(unsigned int count)
+{
+    Pace_given += count;
+    if (Pace_given >= Pace_rate) {
+        Pace_start += 10 * G_TIME_SPAN_SECOND * (Pace_given / Pace_rate);
+        Pace_given %= Pace_rate;
+    }
+}
+
+/* Automatic sizing of fast bursts.  The simulator's time for a burst is
+ * measured from its return until the next call, and the next burst is
+ * scaled to take The_clock.burst_target.  Growth is limited to doubling,
+ * so that one quick burst does not make the next far too long, but a
+ * slow one is cut back at once to keep the panel responsive.
+ */
+
+#define Burst_returned (Ctx->sim->burst_returned) /* Last fast burst began. */
+
+static void size_burst(gint64 returned)
+{
+    gint64  elapsed;
+    guint64 size;
+
+    if (returned == 0 || Burst_given == 0)
+        return;                         /* Not after a fast burst. */
+    elapsed = g_get_monotonic_time() - returned;
+    if (elapsed <= 0) {
+        size = 2 * (guint64)Burst_given;
+    } else {
+        size = ((guint64)Burst_given * The_clock.burst_target) / elapsed;
+        if (size > 2 * (guint64)Burst_given)
+            size = 2 * (guint64)Burst_given;
+    }
+    if (size == 0)
+        size = 1;
+    else if (size > G_MAXUINT)
+        size = G_MAXUINT;
+    The_clock.cycles_fast = (unsigned int)size;
+}
+
 /* Return information on how much to let simulation time advance. */
 
-void Blink_run_control(struct run_control *rcp)
+static void run_control(struct run_control *rcp)
 {
-    static unsigned int cycles;         /* Current burst count. */
-    static int          went;           /* Copy of cp->go. */
-    static int          first;          /* No pause after button. */
+    struct sim_state   *st;
+    gint64              now, wake, returned;
+    guint64             due, limit;
+    unsigned int        rate;
+
+    st = Ctx->sim;
+
+    returned = Burst_returned;
+    Burst_returned = 0;
 
  restart:
-    while (!(cycles || The_clock.run || The_clock.go)) {
+    if (!(st->cycles || The_clock.run || The_clock.go))
+        Wake_display(Ctx);              /* Show the final time. */
+    while (!(st->cycles || The_clock.run || The_clock.go)) {
         /* Wait for command. */
 
         if (snooze(20)) {
             rcp->burst = 0;
             return;
         }
-        first = 1;
+        st->first = 1;
+        returned = 0;                   /* Not timing a burst. */
         if (Sfp->sim_idle)
             (*Sfp->sim_idle)();
     }
 
     rcp->unit = The_clock.unit;
     rcp->rate = The_clock.rate;
-    if (The_clock.fast) {
+    if (The_clock.turbo && The_clock.run) {
+        guint64 left;
+
+        /* Run to the target cycle in the largest bursts possible,
+         * while the UI shows nothing.
+         */
+
+        The_clock.go = 0;
+        st->cycles = 0;
+        if (Sim_time >= The_clock.target) {
+            The_clock.turbo = 0;
+            The_clock.run = 0;
+            Call_UI(Show_stopped, NULL, G_PRIORITY_DEFAULT);
+            rcp->burst = 0;
+            return;
+        }
+        left = The_clock.target - Sim_time;
+        rcp->burst = left > G_MAXUINT ? G_MAXUINT : (unsigned int)left;
+        The_clock.cycle_count += rcp->burst;
+        if (EDITS_PENDING() && push_changed_regs())
+            rcp->burst = 0;
+    } else if (The_clock.fast) {
         /* Free-running - simply hand over parameters. */
 
+        if (The_clock.auto_burst && The_clock.burst_target)
+            size_burst(returned);
         rcp->burst = The_clock.cycles_fast;
+        if (The_clock.cycle_limit) {
+            guint64 left;
+
+            /* Limited run, only used by the headless panel. */
+
+            left = The_clock.cycle_limit - The_clock.cycle_count;
+            if (left == 0)
+                (void)do_exit();        // Main context: no return.
+            if (rcp->burst > left)
+                rcp->burst = left;
+        }
+        The_clock.cycle_count += rcp->burst;
 
         /* Ensure controls are re-examined on next call. */
 
         The_clock.go = 0;
-        cycles = 0;
+        st->cycles = 0;
 
         /* Check for user input. */
 
-        if (User_modified_regs) {
+        if (EDITS_PENDING()) {
             int         rv;
 
             rv = push_changed_regs();
@@ -603,36 +2092,152 @@ void Blink_run_control(struct run_control *rcp)
                 return;
             }
         }
+        Burst_returned = g_get_monotonic_time();
     } else {
-        /* Animation - single-step with pauses. */
+        /* Animation - paced to the wall clock.  Go steps by the
+         * burst size, Run gives all cycles due.
+         */
 
-        rcp->burst = The_clock.cycles_slow;
-        if (cycles == 0) {
-            went = The_clock.go;
+        if (st->cycles == 0) {
+            st->went = The_clock.go;
             The_clock.go = 0;
-            cycles = The_clock.cycles_slow;
+            st->cycles = st->went ? The_clock.cycles_slow : 0;
+        }
+        now = g_get_monotonic_time();
+        rate = The_clock.rate ? The_clock.rate : 1;
+        if (st->first || rate != Pace_rate ||
+            now > pace_time(Pace_given) + PACE_MAX_LAG) {
+            st->first = 0;
+            pace_restart(now, rate);    /* First cycle due now. */
         }
 
-        /* Slow to human speed. */
+        /* Slow to the chosen speed. */
 
-        if (first) {
-            first = 0;
-        } else {
-            if (snooze(rcp->rate)) {
+        due = pace_due(now);
+        if (due == 0) {
+            wake = pace_time(Pace_given);
+            if (rate > MAX_ANIMATED_RATE && wake < now + PACE_TICK)
+                wake = now + PACE_TICK;
+            if (snooze_until(wake)) {
                 rcp->burst = 0;
                 return;
             }
         }
 
-        if (The_clock.go || The_clock.fast || !(went || The_clock.run) ||
-            cycles-- > The_clock.cycles_slow) {
+        if (The_clock.go || The_clock.fast || !(st->went || The_clock.run) ||
+            st->cycles > The_clock.cycles_slow) {
             /* Settings changed while sleeping. */
 
-            cycles = 0;
+            st->cycles = 0;
             goto restart;
         }
-        rcp->burst = 1;
+        if (due == 0)
+            goto restart;               /* Check again after sleeping. */
+        limit = st->went ? st->cycles : pace_limit();
+        rcp->burst = (unsigned int)(due < limit ? due : limit);
+        if (st->went)
+            st->cycles -= rcp->burst;
+        pace_given(rcp->burst);
+    }
+}
+
+/* Signal a change to a simulator waiting on its own event loop. */
+
+static void count_change(struct blink_ctx *Ctx)
+{
+    static const guint64 one = 1;
+    int                  fd;
+
+    __atomic_add_fetch(&Generation.count, 1, __ATOMIC_RELEASE);
+    fd = __atomic_load_n(&Notify_write_fd, __ATOMIC_ACQUIRE);
+    if (fd >= 0) {
+        /* A full pipe or counter is already readable. */
+
+        if (write(fd, &one, sizeof one) < 0 && errno != EAGAIN)
+            perror("Blink notification");
+    }
+}
+
+void Count_change(void)
+{
+    count_change(Ctx);
+}
+
+/* Empty the notification descriptor, before looking for changes. */
+
+static void drain_notify(void)
+{
+    guint64 buff[8];
+
+    if (Notify_fd < 0)
+        return;
+    while (read(Notify_fd, buff, sizeof buff) > 0)
+        ;
+}
+
+/* Locate the change counter read by Blink_changes(). */
+
+const struct blink_generation *Blink_generation_ptr(void)
+{
+    return &Generation;
+}
+
+#ifdef _WIN32
+int Blink_get_fd(void)
+{
+    return -1;                          /* Pipes can not be polled. */
+}
+#else
+int Blink_get_fd(void)
+{
+    int fds[2];
+
+    if (Notify_fd >= 0)
+        return Notify_fd;
+#ifdef __linux__
+    fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fds[0] < 0)
+        return -1;
+#else
+    if (pipe(fds) < 0)
+        return -1;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    Notify_fd = fds[0];
+    __atomic_store_n(&Notify_write_fd, fds[1], __ATOMIC_RELEASE);
+    if (EDITS_PENDING())
+        Count_change();                 /* Queued before the call. */
+    return Notify_fd;
+}
+#endif
+
+/* The previous burst is assumed complete at the next call. */
+
+void Blink_run_control(struct run_control *rcp)
+{
+    if (Ctx->sim->finished) {
+        rcp->unit = The_clock.unit;
+        rcp->rate = The_clock.rate;
+        rcp->burst = 0;
+        return;
+    }
+    if (!Ctx->sim->started) {
+        Ctx->sim->started = TRUE;
+        Trace_start_env();              /* Registers should be known now. */
     }
+    if (Sim_thread != &This_thread)
+        __atomic_store_n(&Sim_thread, &This_thread, __ATOMIC_RELAXED);
+    merge_updates();
+    if (!Exact_time)
+        __atomic_store_n(&Sim_time, Sim_time + Burst_given, __ATOMIC_RELAXED);
+    Capture_poll();
+    drain_notify();
+    if (!watch_stop(rcp))
+        run_control(rcp);
+    Burst_given = rcp->burst;
 }
 
 /* If the simulator needs to take control of execution, this function
@@ -642,7 +2247,14 @@ void Blink_run_control(struct run_control *rcp)
 
 extern void Blink_poll(struct run_control *rcp)
 {
-    if (User_modified_regs)
+    if (Ctx->sim->finished) {
+        Blink_run_control(rcp);         /* Zero burst. */
+        return;
+    }
+    drain_notify();
+    if (on_sim_thread())
+        merge_updates();
+    if (EDITS_PENDING())
         (void)push_changed_regs();
     rcp->unit = The_clock.unit;
     rcp->rate = The_clock.rate;
@@ -650,3 +2262,73 @@ extern void Blink_poll(struct run_control *rcp)
                      The_clock.fast ? The_clock.cycles_fast :
                          The_clock.cycles_slow;
 }
+
+/* Release a finished context, with everything that was made for it.
+ * A producer buffer still claimed by a thread is left for that thread to
+ * free, see release_producer().
+ */
+
+void Blink_free_context(Blink_ctx ctx)
+{
+    struct blink_ctx *caller;
+    struct producer  *pp, *next_pp;
+    struct reg       *rp;
+    char             *block, *next;
+    unsigned int      i;
+
+    if (!ctx || ctx == &Main_ctx)
+        return;
+    caller = (Ctx == ctx) ? &Main_ctx : Ctx;
+    Ctx = ctx;                          /* So that the macros name it. */
+    for (i = 0; i < Reg_count; ++i) {
+        rp = Reg_table[i];
+        if (rp->scope)
+            Scope_free(rp->scope);
+    }
+    Panel_free();                       /* Before its things go. */
+    if (GHt)
+        g_hash_table_destroy(GHt);
+    Trace_free();
+    for (pp = Producers; pp; pp = next_pp) {
+        next_pp = pp->next;
+        g_mutex_lock(&pp->lock);
+        pp->ctx = NULL;                 /* The thread's next value moves on. */
+        pp->next = NULL;
+        g_free(pp->updates);
+        g_free(pp->words);
+        pp->updates = NULL;
+        pp->words = NULL;
+        pp->count = pp->size = pp->words_used = pp->words_size = 0;
+        g_mutex_unlock(&pp->lock);
+        for (;;) {
+            if (g_atomic_int_compare_and_exchange(&pp->in_use, 0, 1)) {
+                g_mutex_clear(&pp->lock);
+                g_free(pp);
+                break;
+            }
+            if (g_atomic_int_compare_and_exchange(&pp->in_use, 1, 2))
+                break;                  /* Freed by release_producer(). */
+        }
+    }
+    Producers = NULL;
+    g_free(ctx->sim->merge.updates);
+    g_free(ctx->sim->merge.words);
+    free(Push_words);
+    g_free(Edits);
+    g_free(Edit_words);
+    if (Notify_fd >= 0) {
+        if (Notify_write_fd != Notify_fd)
+            close(Notify_write_fd);
+        close(Notify_fd);
+    }
+    for (block = Arena_blocks; block; block = next) {
+        next = *(char **)block;
+        free(block);
+    }
+    g_mutex_clear(&Watch_lock);
+    g_mutex_clear(&Simulation_mutex);
+    g_cond_clear(&Simulation_waker);
+    g_free(ctx->sim);
+    g_free(ctx);
+    Ctx = caller;
+}
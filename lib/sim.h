@@ -20,13 +20,36 @@
 #ifndef __SIM_H__
 #define __SIM_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
 /* Simulator-side interface to the Blink library. */
 
 /* Constants and typedefs. */
 
-#define MAX_ITEMS 10
+#define MAX_ITEMS 10     /* Obsolete: containers are no longer limited. */
 typedef struct thing *Blink_CH; /* Container handle. */
 typedef void         *Sim_RH;   /* Simulator's register handle. */
+typedef int           Blink_RID; /* Register ID, see below. */
+typedef struct blink_ctx *Blink_ctx; /* Simulation context, see below. */
+
+/* One user edit, as given to a "push batch" function, below.  For an integer
+ * register, "words" holds the whole value, least significant first,
+ * and "value" its low 32 bits.
+ */
+
+#define BLINK_EDIT_VALUE        0       /* Integer register. */
+#define BLINK_EDIT_FP           1       /* Floating-point register. */
+#define BLINK_EDIT_UNIT         2       /* Units combo-box, no handle. */
+
+struct blink_edit {
+    Sim_RH              handle;
+    unsigned int        kind;
+    unsigned int        value;          /* Or the unit index. */
+    double              fp;             /* For BLINK_EDIT_FP. */
+    const uint64_t     *words;
+    unsigned int        nwords;
+};
 
 /* Initialisation. */
 
@@ -50,8 +73,8 @@ struct simulator_calls {
 
     void (*sim_idle)(void);
 
-    /* Called when the window has been closed. Program exits on return.
-     * This is optional.
+    /* Called when the window has been closed. Program exits on return,
+     * for the main context.  This is optional.
      */
 
     void (*sim_done)(void);
@@ -68,6 +91,49 @@ extern int Blink_init(const char                    *title,
                       const char                   **unit_strings,
                       unsigned int                   initial_unit);
 
+/* Optional callbacks are added by these calls, not to the structure above,
+ * so that simulators built with older versions of this file still work.
+ * Call them after Blink_init().
+ *
+ * A "push wide" function is called in place of sim_push_val() for
+ * registers wider than 32 bits, with (width + 63) / 64 words, least
+ * significant first.  Without it, sim_push_val() receives the low 32 bits.
+ */
+
+extern void Blink_set_push_wide(int (*push_wide)(Sim_RH handle,
+                                                 const uint64_t *words));
+
+/* A "push batch" function is called in place of all the push functions
+ * with every pending edit, in the order made, so that they may be applied
+ * together.  The array is valid only during the call.  The return value
+ * is used as for the others.
+ */
+
+extern void Blink_set_push_batch(int (*push_batch)(
+                                     const struct blink_edit *edits,
+                                     size_t count));
+
+/* Several simulations may run in one process, for example for a parameter
+ * sweep across cores.  Each runs in its own thread, which selects a new
+ * context with Blink_use_context() before calling Blink_init().  The
+ * thread's later calls act on the one it selected, or the context may be
+ * passed to the "_ctx" versions of the calls, listed at the end.  Threads
+ * start with the main context.  The Gtk panel shows each context in its
+ * own window, all run by one UI thread, and the headless library none.
+ * Each context may be traced or captured to its own file, but BLINK_TRACE
+ * applies only to the main one.  When a simulation other than the main
+ * one ends, or its window is closed, its trace and capture are completed,
+ * sim_done() is called and Blink_run_control() and Blink_poll() return a
+ * zero burst from then on, rather than the process exiting.  The thread
+ * should then leave its loop, and Blink_free_context() may release the
+ * context, and its window, which no thread may use afterwards.
+ */
+
+extern Blink_ctx Blink_new_context(void);
+extern void      Blink_use_context(Blink_ctx ctx);
+extern Blink_ctx Blink_get_context(void);
+extern void      Blink_free_context(Blink_ctx ctx);
+
 /* Simulator clock/time control.  This returns a cycle count and the
  * user-selected simulation speed.  The cycle count is the number of cycles
  * (whatever that means) that simulation should advance before calling
@@ -91,6 +157,38 @@ extern void Blink_stopped(void);        // Show simulator stopped. */
 
 extern void Blink_poll(struct run_control *rcp);
 
+/* For a simulator with its own event loop, Blink_get_fd() returns a file
+ * descriptor that becomes readable when the controls change, the user
+ * edits a register, a watch is met or the window closes.  It stays so
+ * until the next call of Blink_poll() or Blink_run_control(), so the
+ * simulator may wait for it with its other inputs, then call Blink_poll().
+ * The descriptor must not be read or closed by the simulator.
+ * Returns -1 on failure, and always on Windows, where a pipe can not be
+ * waited for with other inputs.
+ */
+
+extern int Blink_get_fd(void);
+
+/* Calling Blink_poll() within a long burst is costly, so the panel also
+ * counts every change made by the user to the controls or registers,
+ * and every watch met.  Blink_generation_ptr() locates the counter,
+ * once, and Blink_changes() reads it through that pointer for almost
+ * nothing, so a simulator may test it in its inner loop and call
+ * Blink_poll() or end the burst only when it differs from the value
+ * before.  The counter has a cache line to itself.
+ */
+
+struct blink_generation {
+    unsigned int        count;
+} __attribute__((aligned(64)));
+
+extern const struct blink_generation *Blink_generation_ptr(void);
+
+static inline unsigned int Blink_changes(const struct blink_generation *gp)
+{
+    return __atomic_load_n(&gp->count, __ATOMIC_ACQUIRE);
+}
+
 /* Blink set-up functions. */
 
 /* Create a horizontal row that can contain several items, or an
@@ -111,9 +209,19 @@ extern void Blink_add_to_container(Blink_CH item, Blink_CH container);
 
 extern Blink_CH Blink_new_grid(const char *name, int columns);
 
+/* A list is a container for registers only, shown as a scrolling column
+ * of names and values with the given number of rows visible.  Widgets
+ * are made only for the visible rows, so a list may hold thousands of
+ * registers, and updates to those out of view cost only a store.
+ * Listed registers are shown as text, whatever their style.
+ */
+
+extern Blink_CH Blink_new_list(const char *name, int rows);
+
 /* Create a register and put it in a container, which may be NULL.
  * Width is the number of bits (and buttons for the default option),
- * number of significant figures for FP.
+ * number of significant figures for FP.  There is no limit on the number
+ * of bits, but Blink_new_value() sets only the low 32.
  * Registers may not be modified (value/flags) while their container is open.
  */
 
@@ -121,12 +229,29 @@ extern void Blink_add_register(const char *name, Sim_RH handle,
                                unsigned int width, unsigned int options,
                                Blink_CH container_handle);
 
+/* As above, but also return a register ID: a small integer that may
+ * be passed to the *_id() functions below in place of the handle, to avoid
+ * a hash table lookup.  IDs are allocated densely from zero, and registers
+ * that share a handle share an ID.  Returns -1 on failure.
+ */
+
+extern Blink_RID Blink_add_register_id(const char *name, Sim_RH handle,
+                                       unsigned int width,
+                                       unsigned int options,
+                                       Blink_CH container_handle);
+
 /* Backward compatability. */
 
 #define Blink_new_register(name, handle, width, options) \
     Blink_add_register(name, handle, width, options, NULL)
 
-/* End of set-up, these calls change the display as simulation proceeds. */
+/* End of set-up, these calls change the display as simulation proceeds.
+ * The value and flags calls, by handle or ID, may also be made by threads
+ * other than the one calling Blink_run_control(), after selecting the same
+ * context if it is not the main one.  Their changes are held in a buffer
+ * for each thread and applied together at the start of the next burst;
+ * where threads set the same register, the last call made wins.
+ */
 
 extern void Blink_change_overlay(Blink_CH handle, int value);
 extern void Blink_new_value(Sim_RH handle, unsigned int value);
@@ -134,6 +259,42 @@ extern void Blink_new_FP(Sim_RH handle, double value); // For RO_STYLE_FP.
 extern void Blink_new_flags(Sim_RH handle, unsigned int flags);
 extern void Blink_new_strings(Sim_RH handle, const char * const *table);
 
+/* Set the value or flags of a register of any width, from an array of
+ * (width + 63) / 64 words, least significant first.
+ */
+
+extern void Blink_new_wide_value(Sim_RH handle, const uint64_t *words);
+extern void Blink_new_wide_flags(Sim_RH handle, const uint64_t *words);
+
+/* Update several registers together.  The changes are shown in the
+ * same display frame.
+ */
+
+extern void Blink_new_values(const Sim_RH *handles,
+                             const unsigned int *values, unsigned int count);
+extern void Blink_new_flags_bulk(const Sim_RH *handles,
+                                 const unsigned int *flags,
+                                 unsigned int count);
+
+/* Changes made between these calls are published to the display as a
+ * single batch, so that related registers are never seen half-updated.
+ * (A register that was already waiting to be shown may show its new
+ * value early.)  The calls may be nested.
+ */
+
+extern void Blink_begin_update(void);
+extern void Blink_end_update(void);
+
+/* Faster versions of the above, using IDs.  IDs are not checked unless
+ * the library was compiled with -DDEBUG.
+ */
+
+extern void Blink_new_value_id(Blink_RID id, unsigned int value);
+extern void Blink_new_FP_id(Blink_RID id, double value);
+extern void Blink_new_flags_id(Blink_RID id, unsigned int flags);
+extern void Blink_new_wide_value_id(Blink_RID id, const uint64_t *words);
+extern void Blink_new_wide_flags_id(Blink_RID id, const uint64_t *words);
+
 /* If a client has no means to store Blink's handles it can translate
  * its own.  Used by Verilog VPI for overlays.
  */
@@ -154,6 +315,16 @@ extern void Blink_sim_ctl(unsigned int);
 #define RO_SENSITIVITY 0x20     /* Flags select sensitivity. */
 #define RO_ALT_COLOURS 0x40     /* Flags select alternate colour. */
 
+/* A floating-point register with option RO_SCOPE is plotted like an
+ * oscilloscope trace, with each value from the simulator as one sample.
+ * The latest million samples are kept.  The vertical scale follows the
+ * samples shown, and scrolling over the plot zooms in time.  A click
+ * sets a trigger level, at which rising values are held in the middle
+ * of the plot; a right click removes it.  A middle click shows all samples.
+ */
+
+#define RO_SCOPE       0x80     /* Floating-point styles: plot samples. */
+
 /* The display style is a 3-bit field. */
 
 #define RO_STYLE_MASK     7
@@ -165,6 +336,193 @@ extern void Blink_sim_ctl(unsigned int);
 #define RO_STYLE_FP       5     /* FP number (double) in GtkEntry. */
 #define RO_STYLE_FP_SPIN  6     /* FP number (double) in GtkSpinButton. */
 
+/* A register in the waveform style keeps a history, even without
+ * Blink_set_history(), and is drawn as a strip ending at the present.
+ * Each pixel column covers a power of two cycles: scrolling over the strip
+ * zooms, and a middle click returns to showing all history.
+ */
+
+#define RO_STYLE_WAVE     7     /* Timing diagram of recent history. */
+
+/* Value history.  After Blink_set_history(depth), each register added
+ * keeps its last "depth" values (rounded up to a power of two) with the
+ * time each was set, and the panel gains a control to show all registers
+ * as they were at a past time.  Zero turns history off for registers
+ * added later.  Time is counted in cycles handed out by
+ * Blink_run_control(), but a simulator may instead set the time of
+ * following updates with Blink_set_cycle().
+ */
+
+extern void Blink_set_history(unsigned int depth);
+extern void Blink_set_cycle(uint64_t cycle);
+
+/* Recording of value changes to a file, by a separate thread.  The
+ * registers already added are recorded from their current values until
+ * Blink_trace_stop() or exit.  Setting environment variable BLINK_TRACE
+ * to a file name starts recording at the first call of
+ * Blink_run_control(), in VCD if the name ends ".vcd".
+ * Blink_trace() returns zero, or -1 if the file can not be opened.
+ * The binary format is described in trace.c.
+ */
+
+#define BLINK_TRACE_VCD         0
+#define BLINK_TRACE_BINARY      1
+
+extern int Blink_trace(const char *path, int format);
+extern void Blink_trace_stop(void);
+
+/* Triggered capture, like a logic analyser.  Blink_arm() starts keeping
+ * recent changes of the chosen registers, and tests the trigger condition
+ * at each change of a register it names.  The changes from "before"
+ * cycles before the trigger until "after" cycles after it are then
+ * written to a VCD file.  Conditions test the low 64 bits of integer
+ * registers; with "all" set, all must hold at once, else any one.
+ * Changes are kept in a ring of "depth" changes (default 65536)
+ * allocated when armed, and the file is written by a separate thread.
+ * The panel gains a button to arm again with the same settings.
+ * Blink_arm() returns zero, or -1 for bad arguments.
+ */
+
+#define BLINK_COND_MATCH        0       /* (value & mask) == match. */
+#define BLINK_COND_RISE         1       /* A bit in mask went from 0 to 1. */
+#define BLINK_COND_FALL         2       /* A bit in mask went from 1 to 0. */
+#define BLINK_COND_CHANGE       3       /* A bit in mask changed. */
+#define BLINK_COND_RANGE        4       /* match <= (value & mask) <= limit. */
+
+struct blink_condition {
+    Blink_RID           id;
+    unsigned int        kind;
+    uint64_t            mask;
+    uint64_t            match;
+    uint64_t            limit;
+};
+
+struct blink_capture {
+    const Blink_RID              *ids;          /* Registers recorded. */
+    unsigned int                  count;
+    const struct blink_condition *conditions;
+    unsigned int                  nconditions;
+    int                           all;          /* AND, rather than OR. */
+    uint64_t                      before;       /* Cycles. */
+    uint64_t                      after;
+    unsigned int                  depth;        /* Changes kept, or 0. */
+    const char                   *path;         /* VCD file. */
+};
+
+#define BLINK_CAPTURE_IDLE      0
+#define BLINK_CAPTURE_ARMED     1
+#define BLINK_CAPTURE_TRIGGERED 2
+#define BLINK_CAPTURE_DONE      3       /* File written. */
+
+extern int Blink_arm(const struct blink_capture *cap);
+extern int Blink_capture_state(void);
+
+/* Watches stop the run when a condition on a register is met, without
+ * the simulator's involvement.  The simulation thread tests a watch's
+ * condition, as for a capture trigger, at each change of its register's
+ * value.  The next call to Blink_run_control() then returns a zero burst
+ * and the panel stops, showing the watch met.  To stop on the exact
+ * cycle, a simulator may call Blink_watch_hit() within a burst: it returns
+ * the number of a watch met since the last call of Blink_run_control(),
+ * or -1.  Blink_add_watch() returns a watch number, or -1 for bad
+ * arguments or if all BLINK_WATCHES are in use.  Blink_remove_watch()
+ * removes one, or all when given -1.  A secondary click on a lamp in the
+ * panel adds or removes a BLINK_COND_CHANGE watch on that bit.
+ */
+
+#define BLINK_WATCHES           16
+
+extern int  Blink_add_watch(const struct blink_condition *cond);
+extern void Blink_remove_watch(int watch);
+extern int  Blink_watch_hit(void);
+
+/* Each call above that acts on a context has a version, named with
+ * "_ctx" added, that takes the context as its first argument, so that one
+ * thread may serve several simulations without selecting each in turn.
+ * The calls without it act on the calling thread's context.  NULL is not
+ * accepted for the main context: use the value of Blink_get_context()
+ * from a thread that selected none.
+ */
+
+extern int  Blink_init_ctx(Blink_ctx ctx, const char *title,
+                           const struct simulator_calls *callbacks,
+                           const char **unit_strings,
+                           unsigned int initial_unit);
+extern void Blink_set_push_wide_ctx(Blink_ctx ctx,
+                                    int (*push_wide)(Sim_RH handle,
+                                                     const uint64_t *words));
+extern void Blink_set_push_batch_ctx(Blink_ctx ctx,
+                                     int (*push_batch)(
+                                         const struct blink_edit *edits,
+                                         size_t count));
+extern void Blink_run_control_ctx(Blink_ctx ctx, struct run_control *rcp);
+extern void Blink_stopped_ctx(Blink_ctx ctx);
+extern void Blink_poll_ctx(Blink_ctx ctx, struct run_control *rcp);
+extern int  Blink_get_fd_ctx(Blink_ctx ctx);
+
+extern Blink_CH  Blink_new_row_ctx(Blink_ctx ctx, const char *name);
+extern Blink_CH  Blink_new_overlay_ctx(Blink_ctx ctx, const char *name);
+extern void      Blink_add_to_container_ctx(Blink_ctx ctx, Blink_CH item,
+                                            Blink_CH container);
+extern Blink_CH  Blink_new_grid_ctx(Blink_ctx ctx, const char *name,
+                                    int columns);
+extern Blink_CH  Blink_new_list_ctx(Blink_ctx ctx, const char *name,
+                                    int rows);
+extern void      Blink_add_register_ctx(Blink_ctx ctx, const char *name,
+                                        Sim_RH handle, unsigned int width,
+                                        unsigned int options,
+                                        Blink_CH container_handle);
+extern Blink_RID Blink_add_register_id_ctx(Blink_ctx ctx, const char *name,
+                                           Sim_RH handle, unsigned int width,
+                                           unsigned int options,
+                                           Blink_CH container_handle);
+
+extern void Blink_change_overlay_ctx(Blink_ctx ctx, Blink_CH handle,
+                                     int value);
+extern void Blink_new_value_ctx(Blink_ctx ctx, Sim_RH handle,
+                                unsigned int value);
+extern void Blink_new_FP_ctx(Blink_ctx ctx, Sim_RH handle, double value);
+extern void Blink_new_flags_ctx(Blink_ctx ctx, Sim_RH handle,
+                                unsigned int flags);
+extern void Blink_new_strings_ctx(Blink_ctx ctx, Sim_RH handle,
+                                  const char * const *table);
+extern void Blink_new_wide_value_ctx(Blink_ctx ctx, Sim_RH handle,
+                                     const uint64_t *words);
+extern void Blink_new_wide_flags_ctx(Blink_ctx ctx, Sim_RH handle,
+                                     const uint64_t *words);
+extern void Blink_new_values_ctx(Blink_ctx ctx, const Sim_RH *handles,
+                                 const unsigned int *values,
+                                 unsigned int count);
+extern void Blink_new_flags_bulk_ctx(Blink_ctx ctx, const Sim_RH *handles,
+                                     const unsigned int *flags,
+                                     unsigned int count);
+extern void Blink_begin_update_ctx(Blink_ctx ctx);
+extern void Blink_end_update_ctx(Blink_ctx ctx);
+extern void Blink_new_value_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                   unsigned int value);
+extern void Blink_new_FP_id_ctx(Blink_ctx ctx, Blink_RID id, double value);
+extern void Blink_new_flags_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                   unsigned int flags);
+extern void Blink_new_wide_value_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                        const uint64_t *words);
+extern void Blink_new_wide_flags_id_ctx(Blink_ctx ctx, Blink_RID id,
+                                        const uint64_t *words);
+
+extern void     Blink_store_handle_ctx(Blink_ctx ctx, Blink_CH handle,
+                                       Sim_RH key);
+extern Blink_CH Blink_retrieve_handle_ctx(Blink_ctx ctx, Sim_RH key);
+extern void     Blink_sim_ctl_ctx(Blink_ctx ctx, unsigned int);
+extern void     Blink_set_history_ctx(Blink_ctx ctx, unsigned int depth);
+extern void     Blink_set_cycle_ctx(Blink_ctx ctx, uint64_t cycle);
+
+extern int  Blink_trace_ctx(Blink_ctx ctx, const char *path, int format);
+extern void Blink_trace_stop_ctx(Blink_ctx ctx);
+extern int  Blink_arm_ctx(Blink_ctx ctx, const struct blink_capture *cap);
+extern int  Blink_capture_state_ctx(Blink_ctx ctx);
+extern int  Blink_add_watch_ctx(Blink_ctx ctx,
+                                const struct blink_condition *cond);
+extern void Blink_remove_watch_ctx(Blink_ctx ctx, int watch);
+extern int  Blink_watch_hit_ctx(Blink_ctx ctx);
 
 /* To make the shared library dlopen-friendly, an instance of this structure
  * is provided: struct blink_functs Blink_FPs.
@@ -192,5 +550,91 @@ struct blink_functs {
     Blink_CH (*retrieve_handle)(Sim_RH key);
     void     (*poll)(struct run_control *rcp);
     void     (*sim_ctl)(unsigned int);
+    Blink_RID (*add_register_id)(const char *, Sim_RH, unsigned int,
+                                 unsigned int, Blink_CH);
+    void     (*new_value_id)(Blink_RID, unsigned int);
+    void     (*new_FP_id)(Blink_RID, double);
+    void     (*new_flags_id)(Blink_RID, unsigned int);
+    void     (*new_values)(const Sim_RH *, const unsigned int *, unsigned int);
+    void     (*new_flags_bulk)(const Sim_RH *, const unsigned int *,
+                               unsigned int);
+    void     (*begin_update)(void);
+    void     (*end_update)(void);
+    void     (*new_wide_value)(Sim_RH, const uint64_t *);
+    void     (*new_wide_flags)(Sim_RH, const uint64_t *);
+    void     (*new_wide_value_id)(Blink_RID, const uint64_t *);
+    void     (*new_wide_flags_id)(Blink_RID, const uint64_t *);
+    Blink_CH (*new_list)(const char *, int);
+    void     (*set_history)(unsigned int);
+    void     (*set_cycle)(uint64_t);
+    int      (*trace)(const char *, int);
+    void     (*trace_stop)(void);
+    int      (*arm)(const struct blink_capture *);
+    int      (*capture_state)(void);
+    int      (*add_watch)(const struct blink_condition *);
+    void     (*remove_watch)(int);
+    int      (*watch_hit)(void);
+    const struct blink_generation *(*generation_ptr)(void);
+    int      (*get_fd)(void);
+    Blink_ctx (*new_context)(void);
+    void     (*use_context)(Blink_ctx);
+    Blink_ctx (*get_context)(void);
+    void     (*set_push_wide)(int (*)(Sim_RH, const uint64_t *));
+    void     (*set_push_batch)(int (*)(const struct blink_edit *, size_t));
+    void     (*free_context)(Blink_ctx);
+    int      (*init_ctx)(Blink_ctx, const char *,
+                         const struct simulator_calls *,
+                         const char **,
+                         unsigned int);
+    void     (*run_control_ctx)(Blink_ctx, struct run_control *);
+    void     (*stopped_ctx)(Blink_ctx);
+    void     (*poll_ctx)(Blink_ctx, struct run_control *);
+    int      (*get_fd_ctx)(Blink_ctx);
+    void     (*set_push_wide_ctx)(Blink_ctx,
+                                  int (*)(Sim_RH, const uint64_t *));
+    void     (*set_push_batch_ctx)(Blink_ctx,
+                                   int (*)(const struct blink_edit *,
+                                           size_t));
+    Blink_CH (*new_row_ctx)(Blink_ctx, const char *);
+    Blink_CH (*new_overlay_ctx)(Blink_ctx, const char *);
+    void     (*add_to_container_ctx)(Blink_ctx, Blink_CH, Blink_CH);
+    Blink_CH (*new_grid_ctx)(Blink_ctx, const char *, int);
+    Blink_CH (*new_list_ctx)(Blink_ctx, const char *, int);
+    void     (*add_register_ctx)(Blink_ctx, const char *, Sim_RH,
+                                 unsigned int, unsigned int, Blink_CH);
+    Blink_RID (*add_register_id_ctx)(Blink_ctx, const char *, Sim_RH,
+                                     unsigned int, unsigned int, Blink_CH);
+    void     (*change_overlay_ctx)(Blink_ctx, Blink_CH, int);
+    void     (*new_value_ctx)(Blink_ctx, Sim_RH, unsigned int);
+    void     (*new_FP_ctx)(Blink_ctx, Sim_RH, double);
+    void     (*new_flags_ctx)(Blink_ctx, Sim_RH, unsigned int);
+    void     (*new_strings_ctx)(Blink_ctx, Sim_RH, const char * const *);
+    void     (*new_wide_value_ctx)(Blink_ctx, Sim_RH, const uint64_t *);
+    void     (*new_wide_flags_ctx)(Blink_ctx, Sim_RH, const uint64_t *);
+    void     (*new_values_ctx)(Blink_ctx, const Sim_RH *,
+                               const unsigned int *, unsigned int);
+    void     (*new_flags_bulk_ctx)(Blink_ctx, const Sim_RH *,
+                                   const unsigned int *, unsigned int);
+    void     (*begin_update_ctx)(Blink_ctx);
+    void     (*end_update_ctx)(Blink_ctx);
+    void     (*new_value_id_ctx)(Blink_ctx, Blink_RID, unsigned int);
+    void     (*new_FP_id_ctx)(Blink_ctx, Blink_RID, double);
+    void     (*new_flags_id_ctx)(Blink_ctx, Blink_RID, unsigned int);
+    void     (*new_wide_value_id_ctx)(Blink_ctx, Blink_RID,
+                                      const uint64_t *);
+    void     (*new_wide_flags_id_ctx)(Blink_ctx, Blink_RID,
+                                      const uint64_t *);
+    void     (*store_handle_ctx)(Blink_ctx, Blink_CH, Sim_RH);
+    Blink_CH (*retrieve_handle_ctx)(Blink_ctx, Sim_RH);
+    void     (*sim_ctl_ctx)(Blink_ctx, unsigned int);
+    void     (*set_history_ctx)(Blink_ctx, unsigned int);
+    void     (*set_cycle_ctx)(Blink_ctx, uint64_t);
+    int      (*trace_ctx)(Blink_ctx, const char *, int);
+    void     (*trace_stop_ctx)(Blink_ctx);
+    int      (*arm_ctx)(Blink_ctx, const struct blink_capture *);
+    int      (*capture_state_ctx)(Blink_ctx);
+    int      (*add_watch_ctx)(Blink_ctx, const struct blink_condition *);
+    void     (*remove_watch_ctx)(Blink_ctx, int);
+    int      (*watch_hit_ctx)(Blink_ctx);
 };
 #endif /* __SIM_H__ */
@@ -0,0 +1,862 @@
+/*
+ * Copyright 2024 Giles Atkinson
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA
+ */
+
+/* Recording of register value changes to a file.
+ *
+ * The simulation thread appends each change, as raw words, to a chunk.
+ * Full chunks are passed to a writer thread through a queue and come
+ * back through another, so the simulation never waits for the disk.
+ * If the writer falls behind, more chunks are allocated.
+ *
+ * Two formats are written.  VCD is for use with other tools.  The binary
+ * format is compact and may be read from any point listed in its index:
+ *
+ *   Header:   "BLINKTRC", a version byte (1), then the signal count and,
+ *             for each signal, width, kind (0 integer, 1 floating-point),
+ *             name length and name.  Numbers are unsigned LEB128 varints.
+ *   Records:  a varint tag, then:
+ *               0      time advance (varint);
+ *               1      key frame: reset the time and all values to zero;
+ *               2 + n  new value of signal n: each 64-bit word,
+ *                      least significant first, as a varint of the
+ *                      exclusive-or with the signal's previous value.
+ *             Each key frame is followed by the full time and all values.
+ *   Index:    "BLINKIDX", a varint count, then for each key frame its time
+ *             and file offset as little-endian 64-bit numbers.
+ *   Trailer:  the offset of the index, as above, and "BLINKEND".
+ *
+ * Times are in simulation cycles, as for the value history.  Registers
+ * added after recording starts are not recorded.  Each context has its
+ * own recording and capture, and the writer threads select the context
+ * they serve.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <glib.h>
+
+#include "sim.h"
+#include "no_gtk.h"
+#include "panel.h"
+
+#define CHUNK_WORDS     8192            /* 64kB buffers. */
+#define KEY_INTERVAL    (1024 * 1024)   /* Bytes between key frames. */
+
+struct chunk {
+    unsigned int        used;           /* Words. */
+    guint64             words[CHUNK_WORDS];
+};
+
+/* A recorded register, as known to the writer. */
+
+struct signal {
+    char               *name;
+    unsigned int        width;
+    unsigned int        nwords;         /* Value words. */
+    gboolean            is_fp;
+    guint64            *value;          /* Last written. */
+};
+
+/* Data private to this file, for each context, made when first needed.
+ * Most are named below by macros, with their descriptions.
+ */
+
+struct trace_state {
+    struct chunk               *current;
+    GAsyncQueue                *full, *free;
+    GThread                    *writer;
+    struct signal              *signals;
+    unsigned int                signal_count;
+    int                         format;
+    FILE                       *out;
+    guint64                     out_bytes;
+    guint64                     last_key;
+    guint64                     time;
+    gboolean                    started;
+    GArray                     *index;
+    struct blink_capture        cap;
+    struct signal              *cap_signals;
+    int                        *cap_slot;
+    unsigned char              *cap_tested;
+    unsigned int                cap_ids;
+    guint64                    *cap_last;
+    guint64                    *ring;
+    unsigned int                ring_stride;
+    guint64                     ring_count;
+    guint64                     lost_time;
+    guint64                     trigger_time, end_time;
+    GThread                    *cap_writer;
+};
+
+static struct chunk     Stop;           /* Sentinel, ends a writer. */
+
+/* Simulation thread's state. */
+
+#define Current (Ctx->trace->current)
+#define Full (Ctx->trace->full)
+#define Free (Ctx->trace->free)
+#define Writer (Ctx->trace->writer)
+
+/* Shared, read-only while recording. */
+
+#define Signals (Ctx->trace->signals)
+#define Signal_count (Ctx->trace->signal_count)
+#define Format (Ctx->trace->format)
+
+/* Writer thread's state. */
+
+#define Out (Ctx->trace->out)
+#define Out_bytes (Ctx->trace->out_bytes) /* Written so far. */
+#define Last_key (Ctx->trace->last_key) /* Offset of last key frame. */
+#define Time (Ctx->trace->time)
+#define Started (Ctx->trace->started)   /* Any record written. */
+#define Index (Ctx->trace->index)       /* Pairs of time and offset. */
+
+static void need_trace_state(void)
+{
+    if (!Ctx->trace)
+        Ctx->trace = g_new0(struct trace_state, 1);
+}
+
+/* Output functions for the writer thread. */
+
+static void put_bytes(const void *data, size_t count)
+{
+    fwrite(data, 1, count, Out);
+    Out_bytes += count;
+}
+
+static void put_varint(guint64 value)
+{
+    unsigned char buff[10];
+    unsigned int  n;
+
+    for (n = 0; value >= 0x80; value >>= 7)
+        buff[n++] = (unsigned char)(value | 0x80);
+    buff[n++] = (unsigned char)value;
+    put_bytes(buff, n);
+}
+
+static void put_u64(guint64 value)
+{
+    unsigned char buff[8];
+    unsigned int  i;
+
+    for (i = 0; i < 8; ++i, value >>= 8)
+        buff[i] = (unsigned char)value;
+    put_bytes(buff, 8);
+}
+
+/* VCD identifiers are strings of printable characters.  The writers of
+ * several contexts may run together, so each passes its own buffer.
+ */
+
+#define VCD_ID_SIZE 8
+
+static const char *vcd_id(unsigned int n, char *buff)
+{
+    char *p;
+
+    p = buff;
+    do {
+        *p++ = (char)('!' + n % 94);
+        n /= 94;
+    } while (n);
+    *p = '\0';
+    return buff;
+}
+
+/* VCD output, also used for captures. */
+
+static void vcd_begin(FILE *out)
+{
+    fprintf(out, "$version Blink $end\n"
+                 "$comment Times are simulation cycles. $end\n"
+                 "$timescale 1ns $end\n"
+                 "$scope module blink $end\n");
+}
+
+static void vcd_declare(FILE *out, unsigned int id, const char *name,
+                        unsigned int width, gboolean is_fp)
+{
+    char buff[VCD_ID_SIZE];
+
+    fprintf(out, "$var %s %u %s ",
+            is_fp ? "real" : "wire", is_fp ? 64 : width, vcd_id(id, buff));
+    for (; *name; ++name)
+        putc((*name == ' ' || *name == '\t') ? '_' : *name, out);
+    fprintf(out, " $end\n");
+}
+
+static void vcd_end_definitions(FILE *out)
+{
+    fprintf(out, "$upscope $end\n$enddefinitions $end\n");
+}
+
+static void vcd_value(FILE *out, unsigned int id, unsigned int width,
+                      gboolean is_fp, const guint64 *words)
+{
+    unsigned int i, bit;
+    gboolean     any;
+    double       f;
+    char         buff[VCD_ID_SIZE];
+
+    if (is_fp) {
+        memcpy(&f, words, sizeof f);
+        fprintf(out, "r%.17g %s\n", f, vcd_id(id, buff));
+    } else if (width == 1) {
+        fprintf(out, "%c%s\n", (int)('0' + (words[0] & 1)), vcd_id(id, buff));
+    } else {
+        putc('b', out);
+        for (any = FALSE, i = width; i-- > 0; ) {
+            bit = (words[i / 64] >> (i % 64)) & 1;
+            if (bit || any || i == 0) {
+                putc('0' + bit, out);
+                any = TRUE;
+            }
+        }
+        fprintf(out, " %s\n", vcd_id(id, buff));
+    }
+}
+
+static void header(void)
+{
+    struct signal *sp;
+    unsigned int   i;
+
+    if (Format == BLINK_TRACE_VCD) {
+        vcd_begin(Out);
+        for (i = 0; i < Signal_count; ++i) {
+            sp = Signals + i;
+            vcd_declare(Out, i, sp->name, sp->width, sp->is_fp);
+        }
+        vcd_end_definitions(Out);
+        return;
+    }
+
+    put_bytes("BLINKTRC\1", 9);
+    put_varint(Signal_count);
+    for (i = 0; i < Signal_count; ++i) {
+        sp = Signals + i;
+        put_varint(sp->width);
+        put_bytes(sp->is_fp ? "\1" : "\0", 1);
+        put_varint(strlen(sp->name));
+        put_bytes(sp->name, strlen(sp->name));
+    }
+}
+
+/* Start a key frame in the binary format, from which it may be read
+ * without what went before.
+ */
+
+static void key_frame(guint64 time)
+{
+    struct signal *sp;
+    unsigned int   i, j;
+    guint64        entry[2];
+
+    entry[0] = time;
+    entry[1] = Out_bytes;
+    g_array_append_vals(Index, entry, 2);
+    Last_key = Out_bytes;
+    put_varint(1);
+    put_varint(0);
+    put_varint(time);
+    for (i = 0; i < Signal_count; ++i) {
+        sp = Signals + i;
+        put_varint(2 + i);
+        for (j = 0; j < sp->nwords; ++j)
+            put_varint(sp->value[j]);
+    }
+    Time = time;
+}
+
+/* Write one value change. */
+
+static void write_change(guint64 time, struct signal *sp, unsigned int id,
+                         const guint64 *words)
+{
+    unsigned int i;
+
+    if (Format == BLINK_TRACE_VCD) {
+        if (!Started || time != Time)
+            fprintf(Out, "#%" G_GUINT64_FORMAT "\n", time);
+        Started = TRUE;
+        Time = time;
+        vcd_value(Out, id, sp->width, sp->is_fp, words);
+        return;
+    }
+
+    if (!Started || Out_bytes - Last_key >= KEY_INTERVAL) {
+        Started = TRUE;
+        key_frame(time);
+    } else if (time != Time) {
+        put_varint(0);
+        put_varint(time - Time);
+        Time = time;
+    }
+    put_varint(2 + id);
+    for (i = 0; i < sp->nwords; ++i) {
+        put_varint(words[i] ^ sp->value[i]);
+        sp->value[i] = words[i];
+    }
+}
+
+static void finish(void)
+{
+    guint64      *entries, offset;
+    unsigned int  i;
+
+    if (Format != BLINK_TRACE_VCD) {
+        offset = Out_bytes;
+        put_bytes("BLINKIDX", 8);
+        put_varint(Index->len / 2);
+        entries = (guint64 *)Index->data;
+        for (i = 0; i < Index->len; ++i)
+            put_u64(entries[i]);
+        put_u64(offset);
+        put_bytes("BLINKEND", 8);
+    }
+    g_array_free(Index, TRUE);
+    fclose(Out);
+}
+
+/* The writer thread, passed the context recorded. */
+
+static gpointer writer(gpointer data)
+{
+    struct chunk  *cp;
+    guint64       *wp, *end, id;
+
+    Ctx = (struct blink_ctx *)data;
+    header();
+    for (;;) {
+        cp = g_async_queue_pop(Full);
+        if (cp == &Stop)
+            break;
+        for (wp = cp->words, end = wp + cp->used; wp < end; ) {
+            id = wp[1] >> 32;
+            write_change(wp[0], Signals + id, (unsigned int)id, wp + 2);
+            wp += 2 + (wp[1] & 0xffffffff);
+        }
+        cp->used = 0;
+        g_async_queue_push(Free, cp);
+    }
+    finish();
+    return NULL;
+}
+
+/* Pass the current chunk to the writer and get another.  This and the
+ * capture functions below are passed the context of the register that
+ * changed, as it may not be the thread's.
+ */
+
+static void send_chunk(struct blink_ctx *Ctx)
+{
+    g_async_queue_push(Full, Current);
+    Current = g_async_queue_try_pop(Free);
+    if (!Current) {
+        Current = g_new(struct chunk, 1);
+        Current->used = 0;
+    }
+}
+
+/* Copy n words of a register's value. */
+
+static void copy_value(struct reg *rp, guint64 *words, unsigned int n)
+{
+    unsigned int i;
+
+    if (rp->nwords == 0) {
+        memcpy(words, &rp->fp_value, sizeof (guint64));
+    } else {
+        for (i = 0; i < n; ++i)
+            words[i] = i < rp->nwords ? get_word(reg_value(rp) + i) : 0;
+    }
+}
+
+/* Record a changed value.  Called only if Tracing is set. */
+
+void Trace_change(struct reg *rp)
+{
+    struct blink_ctx *Ctx = rp->ctx;
+    guint64          *wp;
+    unsigned int      n;
+
+    if ((unsigned int)rp->id >= Signal_count)
+        return;                         /* Added later. */
+    n = Signals[rp->id].nwords;
+    if (Current->used + 2 + n > CHUNK_WORDS)
+        send_chunk(Ctx);
+    wp = Current->words + Current->used;
+    wp[0] = Sim_time;
+    wp[1] = ((guint64)rp->id << 32) | n;
+    copy_value(rp, wp + 2, n);
+    Current->used += 2 + n;
+}
+
+/* Describe a register for output. */
+
+static void set_signal(struct signal *sp, struct reg *rp)
+{
+    char buff[32];
+
+    if (rp->name) {
+        sp->name = g_strdup(rp->name);
+    } else {
+        snprintf(buff, sizeof buff, "reg%u", (unsigned int)rp->id);
+        sp->name = g_strdup(buff);
+    }
+    sp->width = rp->width;
+    sp->is_fp = (rp->nwords == 0);
+    sp->nwords = sp->is_fp ? 1 : rp->nwords;
+}
+
+/* Start recording. */
+
+int Blink_trace(const char *path, int format)
+{
+    struct reg    **table;
+    struct chunk   *cp;
+    unsigned int    i, count;
+
+    Blink_trace_stop();
+    need_trace_state();
+    Out = fopen(path, format == BLINK_TRACE_VCD ? "w" : "wb");
+    if (!Out) {
+        fprintf(stderr, "Can not open trace file %s.\n", path);
+        return -1;
+    }
+    Format = format;
+    Out_bytes = Last_key = Time = 0;
+    Started = FALSE;
+    Index = g_array_new(FALSE, FALSE, sizeof (guint64));
+
+    /* Copy the register table. */
+
+    table = Register_table(&count);
+    Signals = g_new(struct signal, count);
+    Signal_count = count;
+    for (i = 0; i < count; ++i) {
+        set_signal(Signals + i, table[i]);
+        if (Signals[i].nwords + 2 > CHUNK_WORDS) {
+            fprintf(stderr, "Register %s is too wide to record.\n",
+                    Signals[i].name);
+            Signals[i].width = 64;
+            Signals[i].nwords = 1;
+        }
+        Signals[i].value = g_new0(guint64, Signals[i].nwords);
+    }
+
+    /* Two chunks to start with, and the writer. */
+
+    Full = g_async_queue_new();
+    Free = g_async_queue_new();
+    cp = g_new(struct chunk, 1);
+    cp->used = 0;
+    g_async_queue_push(Free, cp);
+    Current = g_new(struct chunk, 1);
+    Current->used = 0;
+    Writer = g_thread_new("Blink trace", writer, Ctx);
+    Tracing = TRUE;
+
+    /* Initial values. */
+
+    for (i = 0; i < count; ++i)
+        Trace_change(table[i]);
+    return 0;
+}
+
+/* Stop recording and complete the file. */
+
+void Blink_trace_stop(void)
+{
+    struct chunk *cp;
+    unsigned int  i;
+
+    if (!Tracing)
+        return;
+    Tracing = FALSE;
+    if (Current->used)
+        g_async_queue_push(Full, Current);
+    else
+        g_free(Current);
+    g_async_queue_push(Full, &Stop);
+    g_thread_join(Writer);
+
+    while ((cp = g_async_queue_try_pop(Free)))
+        g_free(cp);
+    g_async_queue_unref(Full);
+    g_async_queue_unref(Free);
+    for (i = 0; i < Signal_count; ++i) {
+        g_free(Signals[i].name);
+        g_free(Signals[i].value);
+    }
+    g_free(Signals);
+    Signals = NULL;
+    Signal_count = 0;
+}
+
+/* Start recording if environment variable BLINK_TRACE names a file.
+ * Names ending ".vcd" give VCD, others the binary format.  Only the main
+ * context is recorded, as other contexts would share the name.
+ */
+
+void Trace_start_env(void)
+{
+    const char *path;
+    size_t      len;
+
+    path = getenv("BLINK_TRACE");
+    if (!path || !*path || Ctx != &Main_ctx)
+        return;
+    len = strlen(path);
+    Blink_trace(path, (len > 4 && !strcmp(path + len - 4, ".vcd")) ?
+                          BLINK_TRACE_VCD : BLINK_TRACE_BINARY);
+}
+
+/* Triggered capture.
+ *
+ * While armed, each change of a recorded register is put in a ring of
+ * fixed-size entries: time, signal number and value words.  An entry
+ * pushed out of the full ring is first copied to its signal's "value",
+ * so the values before the oldest entry are always known.  Changes of
+ * registers named in conditions are tested as they arrive.  When the
+ * trigger has fired and "after" cycles have passed, recording stops and
+ * a thread writes the file.  Only Capture_state and Capture_rearm are
+ * shared with the UI.  The rest belongs to the simulation thread, except
+ * that the writer reads the ring until it is joined.
+ */
+
+#define CAPTURE_DEPTH 65536             /* Default ring entries. */
+
+#define Cap (Ctx->trace->cap)           /* Settings, with copied arrays. */
+#define Cap_signals (Ctx->trace->cap_signals)
+#define Cap_slot (Ctx->trace->cap_slot) /* Signal for each ID, or -1. */
+#define Cap_tested (Ctx->trace->cap_tested) /* For each ID: in a condition? */
+#define Cap_ids (Ctx->trace->cap_ids)   /* Size of the above. */
+#define Cap_last (Ctx->trace->cap_last) /* For each condition: last value. */
+#define Ring (Ctx->trace->ring)
+#define Ring_stride (Ctx->trace->ring_stride) /* Words per entry. */
+#define Ring_count (Ctx->trace->ring_count) /* Entries ever added. */
+#define Lost_time (Ctx->trace->lost_time) /* Of the last entry pushed out. */
+#define Trigger_time (Ctx->trace->trigger_time)
+#define End_time (Ctx->trace->end_time)
+#define Cap_writer (Ctx->trace->cap_writer)
+
+static guint64 *ring_entry(struct blink_ctx *Ctx, guint64 n)
+{
+    return Ring + (n % Cap.depth) * Ring_stride;
+}
+
+/* Write the captured window, for the context passed. */
+
+static gpointer write_capture(gpointer data)
+{
+    struct signal *sp;
+    FILE          *out;
+    guint64        start, n, time, *wp;
+    unsigned int   i;
+
+    Ctx = (struct blink_ctx *)data;
+    out = fopen(Cap.path, "w");
+    if (!out) {
+        fprintf(stderr, "Can not open capture file %s.\n", Cap.path);
+        g_atomic_int_set(&Capture_state, BLINK_CAPTURE_DONE);
+        return NULL;
+    }
+
+    /* Find the values at the start of the window, or as near as known. */
+
+    start = Trigger_time > Cap.before ? Trigger_time - Cap.before : 0;
+    if (start < Lost_time)
+        start = Lost_time;
+    n = Ring_count > Cap.depth ? Ring_count - Cap.depth : 0;
+    for (; n < Ring_count; ++n) {
+        wp = ring_entry(Ctx, n);
+        if (wp[0] > start)
+            break;
+        sp = Cap_signals + wp[1];
+        memcpy(sp->value, wp + 2, sp->nwords * sizeof (guint64));
+    }
+
+    vcd_begin(out);
+    fprintf(out, "$comment Triggered at cycle %" G_GUINT64_FORMAT ". $end\n",
+            Trigger_time);
+    for (i = 0; i < Cap.count; ++i) {
+        sp = Cap_signals + i;
+        vcd_declare(out, i, sp->name, sp->width, sp->is_fp);
+    }
+    vcd_end_definitions(out);
+    fprintf(out, "#%" G_GUINT64_FORMAT "\n$dumpvars\n", start);
+    for (i = 0; i < Cap.count; ++i) {
+        sp = Cap_signals + i;
+        vcd_value(out, i, sp->width, sp->is_fp, sp->value);
+    }
+    fprintf(out, "$end\n");
+
+    for (time = start; n < Ring_count; ++n) {
+        wp = ring_entry(Ctx, n);
+        if (wp[0] != time) {
+            time = wp[0];
+            fprintf(out, "#%" G_GUINT64_FORMAT "\n", time);
+        }
+        sp = Cap_signals + wp[1];
+        vcd_value(out, (unsigned int)wp[1], sp->width, sp->is_fp, wp + 2);
+    }
+    fclose(out);
+    g_atomic_int_set(&Capture_state, BLINK_CAPTURE_DONE);
+    return NULL;
+}
+
+static void join_capture_writer(void)
+{
+    if (Cap_writer) {
+        g_thread_join(Cap_writer);
+        Cap_writer = NULL;
+    }
+}
+
+/* Start or restart recording, from the current values. */
+
+static void start_capture(void)
+{
+    struct reg   **table;
+    unsigned int   i, count;
+
+    join_capture_writer();
+    table = Register_table(&count);
+    for (i = 0; i < Cap.count; ++i)
+        copy_value(table[Cap.ids[i]], Cap_signals[i].value,
+                   Cap_signals[i].nwords);
+    for (i = 0; i < Cap.nconditions; ++i)
+        copy_value(table[Cap.conditions[i].id], Cap_last + i, 1);
+    Ring_count = 0;
+    Lost_time = Sim_time;
+    Capturing = TRUE;
+    g_atomic_int_set(&Capture_state, BLINK_CAPTURE_ARMED);
+}
+
+static void free_capture(void)
+{
+    unsigned int i;
+
+    join_capture_writer();
+    Capturing = FALSE;
+    for (i = 0; i < Cap.count && Cap_signals; ++i) {
+        g_free(Cap_signals[i].name);
+        g_free(Cap_signals[i].value);
+    }
+    g_free(Cap_signals);
+    g_free((gpointer)Cap.ids);
+    g_free((gpointer)Cap.conditions);
+    g_free((gpointer)Cap.path);
+    g_free(Cap_slot);
+    g_free(Cap_tested);
+    g_free(Cap_last);
+    g_free(Ring);
+    Cap_signals = NULL;
+    Ring = NULL;
+}
+
+/* Set up and arm a capture. */
+
+int Blink_arm(const struct blink_capture *cap)
+{
+    struct reg   **table;
+    unsigned int   i, count, id;
+
+    table = Register_table(&count);
+    if (!cap->path || cap->count == 0)
+        return -1;
+    for (i = 0; i < cap->count; ++i) {
+        if ((unsigned int)cap->ids[i] >= count)
+            return -1;
+    }
+    for (i = 0; i < cap->nconditions; ++i) {
+        if ((unsigned int)cap->conditions[i].id >= count ||
+            cap->conditions[i].kind > BLINK_COND_RANGE) {
+            return -1;
+        }
+    }
+
+    need_trace_state();
+    free_capture();
+    Cap = *cap;
+    if (!Cap.depth)
+        Cap.depth = CAPTURE_DEPTH;
+    Cap.ids = g_new(Blink_RID, cap->count);
+    memcpy((gpointer)Cap.ids, cap->ids, cap->count * sizeof (Blink_RID));
+    Cap.conditions = g_new(struct blink_condition, cap->nconditions + 1);
+    memcpy((gpointer)Cap.conditions, cap->conditions,
+           cap->nconditions * sizeof (struct blink_condition));
+    Cap.path = g_strdup(cap->path);
+
+    /* Tables indexed by register ID. */
+
+    Cap_ids = count;
+    Cap_slot = g_new(int, count);
+    for (i = 0; i < count; ++i)
+        Cap_slot[i] = -1;
+    Cap_tested = g_new0(unsigned char, count);
+    Cap_last = g_new(guint64, cap->nconditions + 1);
+    for (i = 0; i < cap->nconditions; ++i)
+        Cap_tested[cap->conditions[i].id] = 1;
+
+    Cap_signals = g_new(struct signal, cap->count);
+    Ring_stride = 3;
+    for (i = 0; i < cap->count; ++i) {
+        id = cap->ids[i];
+        set_signal(Cap_signals + i, table[id]);
+        Cap_signals[i].value = g_new0(guint64, Cap_signals[i].nwords);
+        if (Cap_slot[id] < 0)
+            Cap_slot[id] = i;
+        if (Cap_signals[i].nwords + 2 > Ring_stride)
+            Ring_stride = Cap_signals[i].nwords + 2;
+    }
+    Ring = g_new(guint64, (gsize)Cap.depth * Ring_stride);
+    start_capture();
+    return 0;
+}
+
+int Blink_capture_state(void)
+{
+    return g_atomic_int_get(&Capture_state);
+}
+
+/* Test the trigger condition after a change to a register. */
+
+static gboolean test_trigger(struct blink_ctx *Ctx, struct reg *rp)
+{
+    const struct blink_condition *cp;
+    guint64                       old;
+    gboolean                      hit, any, all;
+    unsigned int                  i;
+
+    any = FALSE;
+    all = TRUE;
+    for (i = 0; i < Cap.nconditions; ++i) {
+        cp = Cap.conditions + i;
+        old = Cap_last[i];
+        if (cp->id == rp->id)
+            copy_value(rp, Cap_last + i, 1);
+        hit = Condition_met(cp, old, Cap_last[i]);
+        any |= hit;
+        all &= hit;
+    }
+    return Cap.all ? all : any;
+}
+
+/* Stop recording and start the writer. */
+
+static void finish_capture(struct blink_ctx *Ctx)
+{
+    Capturing = FALSE;
+    Cap_writer = g_thread_new("Blink capture", write_capture, Ctx);
+}
+
+/* A register changed.  Called only if Capturing is set. */
+
+void Capture_change(struct reg *rp)
+{
+    struct blink_ctx *Ctx = rp->ctx;
+    struct signal    *sp;
+    guint64          *wp;
+    unsigned int      id;
+    int               slot;
+
+    id = (unsigned int)rp->id;
+    if (id >= Cap_ids)
+        return;                         /* Added later. */
+    if (g_atomic_int_get(&Capture_state) == BLINK_CAPTURE_TRIGGERED &&
+        Sim_time > End_time) {
+        finish_capture(Ctx);
+        return;
+    }
+    slot = Cap_slot[id];
+    if (slot >= 0) {
+        wp = ring_entry(Ctx, Ring_count);
+        if (Ring_count >= Cap.depth) {  /* Push out the oldest. */
+            sp = Cap_signals + wp[1];
+            memcpy(sp->value, wp + 2, sp->nwords * sizeof (guint64));
+            Lost_time = wp[0];
+        }
+        wp[0] = Sim_time;
+        wp[1] = slot;
+        copy_value(rp, wp + 2, Cap_signals[slot].nwords);
+        ++Ring_count;
+    }
+    if (Cap_tested[id] &&
+        g_atomic_int_get(&Capture_state) == BLINK_CAPTURE_ARMED &&
+        test_trigger(Ctx, rp)) {
+        Trigger_time = Sim_time;
+        End_time = Trigger_time + Cap.after;
+        if (End_time < Trigger_time)
+            End_time = G_MAXUINT64;
+        g_atomic_int_set(&Capture_state, BLINK_CAPTURE_TRIGGERED);
+    }
+}
+
+/* Called by the simulation thread before each burst: end a capture when
+ * time has passed, or re-arm on request from the UI.
+ */
+
+void Capture_poll(void)
+{
+    if (!Ctx->trace)
+        return;                         /* Never armed. */
+    if (g_atomic_int_get(&Capture_rearm)) {
+        g_atomic_int_set(&Capture_rearm, FALSE);
+        if (Ring)
+            start_capture();
+    }
+    if (Capturing &&
+        g_atomic_int_get(&Capture_state) == BLINK_CAPTURE_TRIGGERED &&
+        Sim_time > End_time) {
+        finish_capture(Ctx);
+    }
+}
+
+/* At exit: write a capture that has triggered, and wait for the writer. */
+
+void Capture_stop(void)
+{
+    if (!Ctx->trace)
+        return;
+    if (Capturing &&
+        g_atomic_int_get(&Capture_state) == BLINK_CAPTURE_TRIGGERED) {
+        finish_capture(Ctx);
+    }
+    join_capture_writer();
+}
+
+/* Release the calling thread's context's recording and capture. */
+
+void Trace_free(void)
+{
+    if (!Ctx->trace)
+        return;
+    Blink_trace_stop();
+    Capture_stop();
+    free_capture();
+    g_free(Ctx->trace);
+    Ctx->trace = NULL;
+}
@@ -19,6 +19,7 @@
  */
 
 #include <vpi_user.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <libgen.h>
@@ -104,6 +105,50 @@ static int push_val(void *handle, unsigned int value)
     return 0;
 }
 
+/* Registers wider than 32 bits are passed as vectors of 32-bit chunks,
+ * converted here to and from Blink's 64-bit words.  X and Z bits are
+ * shown as their "aval" bits.
+ */
+
+static s_vpi_vecval *Vector;
+static uint64_t     *Words;
+static unsigned int  Chunks_size;
+
+static void size_buffers(unsigned int chunks)
+{
+    if (chunks <= Chunks_size)
+        return;
+    Chunks_size = chunks + 1;           /* Even, room for a whole word. */
+    Vector = realloc(Vector, Chunks_size * sizeof *Vector);
+    Words = realloc(Words, (Chunks_size / 2 + 1) * sizeof *Words);
+    if (!Vector || !Words) {
+        vpi_printf("No memory for wide register values.\n");
+        exit(1);
+    }
+}
+
+/* Function called by Blink with a new value for a wide register. */
+
+static int push_wide(void *handle, const uint64_t *words)
+{
+    struct __vpiHandle *h = (struct __vpiHandle *)handle;
+    s_vpi_value         val;
+    unsigned int        chunks, i;
+
+    chunks = (vpi_get(vpiSize, h) + 31) / 32;
+    size_buffers(chunks);
+    for (i = 0; i < chunks; ++i) {
+        Vector[i].aval = (PLI_INT32)(words[i / 2] >> (32 * (i & 1)));
+        Vector[i].bval = 0;
+    }
+    Pushing = 1;
+    val.format = vpiVectorVal;
+    val.value.vector = Vector;
+    vpi_put_value(h, &val, NULL, vpiNoDelay);
+    Pushing = 0;
+    return 0;
+}
+
 /* VPI function to control the clock.  This is called from Verilog code,
  * and returns the rate and number of time steps the simulation should advance.
  */
@@ -130,8 +175,25 @@ static PLI_INT32 get_clock(char *user_data UNUSED)
 
 PLI_INT32 vc_cb(struct t_cb_data *cb)
 {
-    if (!Pushing)       // Do not reflect back values set bu user.
+    s_vpi_vecval *vp;
+    unsigned int  chunks, i;
+
+    if (Pushing)        // Do not reflect back values set bu user.
+        return 0;
+    if (cb->value->format != vpiVectorVal) {
         Blink_new_value(cb->obj, cb->value->value.integer);
+        return 0;
+    }
+    chunks = (vpi_get(vpiSize, cb->obj) + 31) / 32;
+    size_buffers(chunks);
+    vp = cb->value->value.vector;
+    for (i = 0; i < chunks; ++i) {
+        if (i & 1)
+            Words[i / 2] |= (uint64_t)(uint32_t)vp[i].aval << 32;
+        else
+            Words[i / 2] = (uint32_t)vp[i].aval;
+    }
+    Blink_new_wide_value(cb->obj, Words);
     return 0;
 }
 
@@ -156,18 +218,22 @@ PLI_INT32 ov_cb(struct t_cb_data *cb)
     return 0;
 }
 
-/* Set a value-change callback on something. */
+/* Set a value-change callback on something, with values given in
+ * "format": vpiIntVal, or vpiVectorVal for wide registers.
+ */
 
 static vpiHandle set_watch(vpiHandle handle,
-                           PLI_INT32 (*fn)(struct t_cb_data *))
+                           PLI_INT32 (*fn)(struct t_cb_data *),
+                           PLI_INT32 format)
 {
     static s_vpi_time        s_time = {.type = vpiSuppressTime};
-    static s_vpi_value       s_value = {.format = vpiIntVal};
+    static s_vpi_value       s_value;
     static struct t_cb_data  cb = {
                                  .reason = cbValueChange,
                                  .time = &s_time, .value = &s_value
                              };
 
+    s_value.format = format;
     cb.obj = handle;
     cb.cb_rtn = fn;
     return vpi_register_cb(&cb);
@@ -205,7 +271,7 @@ static int record_register(vpiHandle argv, Blink_CH row_handle)
 
     /* Callback here, vpi_register_cb() with vpiSuppressTime. */
 
-    if (!set_watch(reg, vc_cb))
+    if (!set_watch(reg, vc_cb, width > 32 ? vpiVectorVal : vpiIntVal))
         vpi_printf("Failed to add callback for register %s\n", name);
 
     return 1;
@@ -249,10 +315,8 @@ static PLI_INT32 declare_row(char *user_data UNUSED)
 
     /* Get the contents. */
 
-    for (count = 0; count < MAX_ITEMS; count++) {
-        if (!record_register(argv, row_handle))
-            break;
-    }
+    for (count = 0; record_register(argv, row_handle); count++)
+        ;
     if (count == 0)
         return 0;       /* No items. */
 
@@ -294,7 +358,7 @@ static PLI_INT32 start_overlay(char *user_data UNUSED)
 
     /* Set watch on it. */
 
-    set_watch(expr, ov_cb);
+    set_watch(expr, ov_cb, vpiIntVal);
     return 0;
 }
 
@@ -345,6 +409,7 @@ static PLI_INT32 start_cb(struct t_cb_data *cb)
 {
     if (!Blink_init(cb->user_data, &blink_functions, NULL, 0))
         exit(1);
+    Blink_set_push_wide(push_wide);
     return 0;
 }
 